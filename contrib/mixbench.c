@@ -0,0 +1,217 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* Throughput of BarMixConvert compared to the libavfilter chain it replaced
+ * (volume, then aformat to interleaved S16). Not part of the normal build:
+ *
+ *	make mixbench && ./mixbench [seconds of audio]
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include <libavfilter/avfilter.h>
+#include <libavfilter/buffersink.h>
+#include <libavfilter/buffersrc.h>
+#include <libavutil/avutil.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/frame.h>
+
+#include "mix.h"
+
+static const int rate = 44100;
+static const int channels = 2;
+static const int blockSamples = 1024;
+/* -6 dB */
+static const float gain = 0.5f;
+
+static double now (void) {
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void die (const char * const msg) {
+	fprintf (stderr, "%s\n", msg);
+	exit (EXIT_FAILURE);
+}
+
+/*	One block of planar float, like the decoders produce
+ */
+static AVFrame *makeFrame (void) {
+	static const double twoPi = 6.283185307179586;
+
+	AVFrame * const frame = av_frame_alloc ();
+	if (frame == NULL) {
+		die ("av_frame_alloc");
+	}
+	frame->format = AV_SAMPLE_FMT_FLTP;
+	frame->sample_rate = rate;
+	frame->nb_samples = blockSamples;
+	av_channel_layout_default (&frame->ch_layout, channels);
+	if (av_frame_get_buffer (frame, 0) < 0) {
+		die ("av_frame_get_buffer");
+	}
+	for (int c = 0; c < channels; c++) {
+		float * const p = (float *) frame->extended_data[c];
+		for (int i = 0; i < blockSamples; i++) {
+			p[i] = 0.9 * sin (twoPi * 440 * (c+1) * i / rate);
+		}
+	}
+	return frame;
+}
+
+/*	abuffer -> volume -> aformat -> abuffersink, as the player used to
+ */
+static AVFilterGraph *openGraph (AVFilterContext ** const src,
+		AVFilterContext ** const sink) {
+	char args[256];
+	AVFilterContext *volume, *format;
+	AVFilterGraph *graph = avfilter_graph_alloc ();
+	if (graph == NULL) {
+		return NULL;
+	}
+
+	snprintf (args, sizeof (args),
+			"time_base=1/%d:sample_rate=%d:sample_fmt=fltp:channel_layout=stereo",
+			rate, rate);
+	if (avfilter_graph_create_filter (src, avfilter_get_by_name ("abuffer"),
+			"source", args, NULL, graph) < 0 ||
+			avfilter_graph_create_filter (&volume,
+			avfilter_get_by_name ("volume"), "volume", "volume=0.5", NULL,
+			graph) < 0 ||
+			avfilter_graph_create_filter (&format,
+			avfilter_get_by_name ("aformat"), "format", "sample_fmts=s16",
+			NULL, graph) < 0 ||
+			avfilter_graph_create_filter (sink,
+			avfilter_get_by_name ("abuffersink"), "sink", NULL, NULL,
+			graph) < 0 ||
+			avfilter_link (*src, 0, volume, 0) != 0 ||
+			avfilter_link (volume, 0, format, 0) != 0 ||
+			avfilter_link (format, 0, *sink, 0) != 0 ||
+			avfilter_graph_config (graph, NULL) < 0) {
+		avfilter_graph_free (&graph);
+		return NULL;
+	}
+	return graph;
+}
+
+/*	@return seconds spent
+ */
+static double benchGraph (const AVFrame * const in, const size_t blocks) {
+	AVFilterContext *src, *sink;
+	AVFilterGraph *graph = openGraph (&src, &sink);
+	if (graph == NULL) {
+		die ("cannot create filter graph");
+	}
+	AVFrame *frame = av_frame_clone (in), *out = av_frame_alloc ();
+	if (frame == NULL || out == NULL) {
+		die ("av_frame_alloc");
+	}
+
+	const double start = now ();
+	for (size_t i = 0; i < blocks; i++) {
+		frame->pts = i * blockSamples;
+		if (av_buffersrc_write_frame (src, frame) < 0) {
+			die ("av_buffersrc_write_frame");
+		}
+		while (av_buffersink_get_frame (sink, out) >= 0) {
+			av_frame_unref (out);
+		}
+	}
+	const double elapsed = now () - start;
+
+	av_frame_free (&frame);
+	av_frame_free (&out);
+	avfilter_graph_free (&graph);
+	return elapsed;
+}
+
+/*	@return seconds spent
+ */
+static double benchMix (const AVFrame * const in, const size_t blocks,
+		const BarMixFormat_t format, const bool dither) {
+	static BarMix_t mix;
+	BarMixInit (&mix);
+	void * const dst = malloc (blockSamples * channels *
+			BarMixSampleSize (format));
+	if (dst == NULL) {
+		die ("malloc");
+	}
+	const float *planes[BAR_MIX_MAXCHANNELS];
+	for (int c = 0; c < channels; c++) {
+		planes[c] = (const float *) in->extended_data[c];
+	}
+
+	const double start = now ();
+	for (size_t i = 0; i < blocks; i++) {
+		BarMixConvert (&mix, dst, format, planes, channels, blockSamples,
+				gain, dither);
+	}
+	const double elapsed = now () - start;
+
+	free (dst);
+	return elapsed;
+}
+
+static void report (const char * const name, const double elapsed,
+		const double audioSecs, const double reference) {
+	printf ("%-28s %8.3f s %10.0fx realtime %6.1fx\n", name, elapsed,
+			audioSecs / elapsed, reference / elapsed);
+}
+
+int main (int argc, char **argv) {
+	const double audioSecs = argc > 1 ? atof (argv[1]) : 3600;
+	if (audioSecs <= 0) {
+		die ("usage: mixbench [seconds of audio]");
+	}
+	const size_t blocks = audioSecs * rate / blockSamples;
+
+	av_log_set_level (AV_LOG_ERROR);
+#ifdef HAVE_AVFILTER_REGISTER_ALL
+	avfilter_register_all ();
+#endif
+
+	AVFrame *frame = makeFrame ();
+	printf ("%i channels, %i Hz, %i samples per block, %.0f s of audio\n",
+			channels, rate, blockSamples, audioSecs);
+
+	const double graph = benchGraph (frame, blocks);
+	report ("libavfilter volume+aformat", graph, audioSecs, graph);
+	report ("BarMixConvert s16", benchMix (frame, blocks, BAR_MIX_S16, false),
+			audioSecs, graph);
+	report ("BarMixConvert s16 dither", benchMix (frame, blocks, BAR_MIX_S16,
+			true), audioSecs, graph);
+	report ("BarMixConvert s32", benchMix (frame, blocks, BAR_MIX_S32, false),
+			audioSecs, graph);
+	report ("BarMixConvert f32", benchMix (frame, blocks, BAR_MIX_F32, false),
+			audioSecs, graph);
+
+	av_frame_free (&frame);
+	return EXIT_SUCCESS;
+}
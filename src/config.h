@@ -14,13 +14,6 @@
 #include <libavfilter/version.h>
 #include <libavformat/version.h>
 
-/* does graph_send_command exist (ffmpeg >=2.2) */
-#if !defined(HAVE_AVFILTER_GRAPH_SEND_COMMAND) && \
-		LIBAVFILTER_VERSION_MAJOR >= 4 && \
-		LIBAVFILTER_VERSION_MICRO >= 100
-#define HAVE_AVFILTER_GRAPH_SEND_COMMAND
-#endif
-
 /* explicit init is optional for ffmpeg>=4.0 */
 #if !defined(HAVE_AVFORMAT_NETWORK_INIT) && \
 		LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 5, 100) && \
@@ -0,0 +1,510 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+/* network fetch thread.
+ *
+ * BarFetchThread reads from the server as fast as possible, until the ring
+ * buffer is full. The decoder reads from the ring through fetchRead, which
+ * blocks until data arrives. Seeking outside of the buffered window is
+ * handed over to the fetch thread, which reconnects at the new offset.
+ *
+ * A watchdog compares the download rate with the stream’s bitrate. If the
+ * buffer would run dry before the connection recovers, a new connection
+ * resuming at the end of the ring is opened and replaces the old one.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fetch.h"
+#include "debug.h"
+
+/* AVIOContext buffer size */
+#define BAR_FETCH_IOSIZE (32*1024)
+/* minimum time spent reading for one throughput sample */
+#define BAR_FETCH_SAMPLENS (500*1000*1000ULL)
+/* watchdog interval */
+#define BAR_FETCH_WINDOWNS (1000*1000*1000ULL)
+/* minimum time between two reconnects */
+#define BAR_FETCH_RECONNECTNS (10*1000*1000*1000ULL)
+/* reconnect if the buffer runs dry within this time */
+#define BAR_FETCH_MARGINMS 5000
+
+/*	Interrupt callback for both threads
+ */
+static int fetchIntCb (void * const data) {
+	BarFetch_t * const fetch = data;
+	if (__atomic_load_n (&fetch->quit, __ATOMIC_ACQUIRE)) {
+		return 1;
+	}
+	return fetch->userCb.callback != NULL &&
+			fetch->userCb.callback (fetch->userCb.opaque);
+}
+
+/*	Drop up to n bytes from the front of the ring, caller must hold lock
+ */
+static void fetchDrop (BarFetch_t * const fetch, size_t n) {
+	if (n > fetch->len) {
+		n = fetch->len;
+	}
+	fetch->start = (fetch->start + n) % fetch->size;
+	fetch->len -= n;
+	fetch->pos += n;
+}
+
+static uint64_t fetchNow () {
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*	Stall watchdog, fetch thread only. Called after every read and
+ *	periodically by libavformat while waiting for data.
+ *	@return true if the connection should be replaced
+ */
+static bool fetchStalled (BarFetch_t * const fetch) {
+	const unsigned int byteRate = __atomic_load_n (&fetch->byteRate,
+			__ATOMIC_ACQUIRE);
+	const uint64_t now = fetchNow ();
+	if (byteRate == 0 || now - fetch->windowStart < BAR_FETCH_WINDOWNS) {
+		return false;
+	}
+
+	/* bytes per second received during the last window */
+	const uint64_t rate = fetch->windowBytes * 1000000000ULL /
+			(now - fetch->windowStart);
+	fetch->windowStart = now;
+	fetch->windowBytes = 0;
+	if (rate >= byteRate || now - fetch->lastReconnect < BAR_FETCH_RECONNECTNS) {
+		return false;
+	}
+
+	/* the decoder may change len concurrently, but an estimate is fine */
+	const uint64_t remainingMs = __atomic_load_n (&fetch->downstreamMs,
+			__ATOMIC_ACQUIRE) + __atomic_load_n (&fetch->len,
+			__ATOMIC_RELAXED) * 1000 / byteRate;
+	/* at the current rate the buffer is empty after */
+	const uint64_t dryMs = remainingMs * byteRate / (byteRate - rate);
+	if (dryMs >= BAR_FETCH_MARGINMS) {
+		return false;
+	}
+
+	debugPrint (DEBUG_NETWORK, "fetch: stalled, %"PRIu64" of %u bytes/s, "
+			"buffer dry in %"PRIu64" ms\n", rate, byteRate, dryMs);
+	return true;
+}
+
+/*	Interrupt callback for the network connection
+ */
+static int fetchSrcIntCb (void * const data) {
+	BarFetch_t * const fetch = data;
+	if (fetchIntCb (fetch)) {
+		return 1;
+	}
+	if (fetchStalled (fetch)) {
+		fetch->stalled = true;
+		return 1;
+	}
+	return 0;
+}
+
+/*	Replace stalled connection with a new one resuming at the end of the
+ *	ring. The old connection is kept until the new one is established and
+ *	keeps being used if that fails. Caller must hold lock.
+ */
+static void fetchReconnect (BarFetch_t * const fetch) {
+	const int64_t offset = fetch->pos + fetch->len;
+	fetch->lastReconnect = fetchNow ();
+	fetch->stalled = false;
+
+	pthread_mutex_unlock (&fetch->lock);
+	AVIOContext *src = NULL;
+	AVDictionary *options = NULL;
+	av_dict_copy (&options, fetch->options, 0);
+	int64_t ret = avio_open2 (&src, fetch->url, AVIO_FLAG_READ, &fetch->srcCb,
+			&options);
+	av_dict_free (&options);
+	if (ret >= 0 && offset > 0) {
+		ret = avio_seek (src, offset, SEEK_SET);
+	}
+	if (ret < 0) {
+		debugPrint (DEBUG_NETWORK, "fetch: reconnect at %"PRIi64" failed with "
+				"%"PRIi64", keeping old connection\n", offset, ret);
+		if (src != NULL) {
+			avio_closep (&src);
+		}
+	} else {
+		debugPrint (DEBUG_NETWORK, "fetch: reconnected at %"PRIi64"\n", offset);
+		avio_closep (&fetch->src);
+		fetch->src = src;
+	}
+	fetch->windowStart = fetchNow ();
+	fetch->windowBytes = 0;
+	pthread_mutex_lock (&fetch->lock);
+}
+
+/*	Account n bytes read in ns nanoseconds. Only time spent reading counts,
+ *	so a full buffer does not lower the rate. Caller must hold lock.
+ */
+static void fetchMeasure (BarFetch_t * const fetch, const size_t n,
+		const uint64_t ns) {
+	fetch->sampleBytes += n;
+	fetch->sampleNs += ns;
+	if (fetch->sampleNs >= BAR_FETCH_SAMPLENS) {
+		const unsigned int rate = fetch->sampleBytes * 8 * 1000000 /
+				fetch->sampleNs;
+		const unsigned int old = fetch->throughput;
+		/* moving average */
+		__atomic_store_n (&fetch->throughput, old == 0 ? rate : (old*3 + rate)/4,
+				__ATOMIC_RELEASE);
+		fetch->sampleBytes = 0;
+		fetch->sampleNs = 0;
+	}
+}
+
+/*	Reconnect at offset fetch->seekTo, caller must hold lock
+ */
+static void fetchSeek (BarFetch_t * const fetch) {
+	const int64_t target = fetch->seekTo;
+
+	pthread_mutex_unlock (&fetch->lock);
+	const int64_t ret = avio_seek (fetch->src, target, SEEK_SET);
+	pthread_mutex_lock (&fetch->lock);
+
+	debugPrint (DEBUG_NETWORK, "fetch: seek to %"PRIi64" returned %"PRIi64"\n",
+			target, ret);
+	fetch->start = 0;
+	fetch->len = 0;
+	if (ret < 0) {
+		fetch->error = ret;
+		fetch->eof = true;
+	} else {
+		fetch->pos = ret;
+		fetch->error = 0;
+		fetch->eof = false;
+	}
+	fetch->seekTo = -1;
+	pthread_cond_broadcast (&fetch->cond);
+}
+
+static void *BarFetchThread (void *data) {
+	BarFetch_t * const fetch = data;
+
+	pthread_mutex_lock (&fetch->lock);
+	while (!fetch->quit) {
+		if (fetch->seekTo >= 0) {
+			fetchSeek (fetch);
+			continue;
+		}
+		if (fetch->eof || fetch->len == fetch->size) {
+			/* done or buffer full, wait for the decoder */
+			pthread_cond_wait (&fetch->cond, &fetch->lock);
+			/* not reading is not a stall */
+			fetch->windowStart = fetchNow ();
+			fetch->windowBytes = 0;
+			continue;
+		}
+
+		/* contiguous free space */
+		const size_t w = (fetch->start + fetch->len) % fetch->size;
+		size_t n = fetch->size - fetch->len;
+		if (n > fetch->size - w) {
+			n = fetch->size - w;
+		}
+		if (n > INT_MAX) {
+			n = INT_MAX;
+		}
+
+		/* the decoder never touches the free part of the buffer */
+		pthread_mutex_unlock (&fetch->lock);
+		const uint64_t readStart = fetchNow ();
+		const int ret = avio_read_partial (fetch->src, &fetch->buf[w], n);
+		const uint64_t readNs = fetchNow () - readStart;
+		pthread_mutex_lock (&fetch->lock);
+
+		if (fetch->seekTo >= 0) {
+			/* data belongs to the old position */
+			continue;
+		}
+		if (ret > 0) {
+			fetch->len += ret;
+			fetch->windowBytes += ret;
+			fetchMeasure (fetch, ret, readNs);
+			if (fetch->stalled || fetchStalled (fetch)) {
+				fetchReconnect (fetch);
+			}
+		} else if (ret == 0) {
+			continue;
+		} else if (fetch->stalled) {
+			/* interrupted by the watchdog */
+			fetchReconnect (fetch);
+			continue;
+		} else {
+			debugPrint (DEBUG_NETWORK, "fetch: read returned %i (%s) after "
+					"%"PRIi64" bytes\n", ret, av_err2str (ret),
+					fetch->pos + (int64_t) fetch->len);
+			fetch->error = ret == AVERROR_EOF ? 0 : ret;
+			fetch->eof = true;
+		}
+		pthread_cond_broadcast (&fetch->cond);
+	}
+	pthread_mutex_unlock (&fetch->lock);
+
+	return NULL;
+}
+
+/*	AVIOContext read callback, called by the decoder thread
+ */
+static int fetchRead (void *data, uint8_t *out, int outSize) {
+	BarFetch_t * const fetch = data;
+	int ret = 0;
+
+	pthread_mutex_lock (&fetch->lock);
+	while (fetch->len == 0 && !fetch->eof && fetch->seekTo < 0) {
+		pthread_mutex_unlock (&fetch->lock);
+		const bool abort = fetchIntCb (fetch);
+		pthread_mutex_lock (&fetch->lock);
+		if (abort) {
+			pthread_mutex_unlock (&fetch->lock);
+			return AVERROR_EXIT;
+		}
+		/* check the interrupt callback periodically, like libavformat */
+		struct timespec deadline;
+		clock_gettime (CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += 100*1000*1000;
+		if (deadline.tv_nsec >= 1000*1000*1000) {
+			deadline.tv_nsec -= 1000*1000*1000;
+			++deadline.tv_sec;
+		}
+		pthread_cond_timedwait (&fetch->cond, &fetch->lock, &deadline);
+	}
+
+	while (fetch->len > 0 && ret < outSize) {
+		size_t n = fetch->size - fetch->start;
+		if (n > fetch->len) {
+			n = fetch->len;
+		}
+		if (n > (size_t) (outSize - ret)) {
+			n = outSize - ret;
+		}
+		memcpy (&out[ret], &fetch->buf[fetch->start], n);
+		fetchDrop (fetch, n);
+		ret += n;
+	}
+	if (ret == 0) {
+		ret = fetch->error != 0 ? fetch->error : AVERROR_EOF;
+	}
+	/* there is space again */
+	pthread_cond_broadcast (&fetch->cond);
+	pthread_mutex_unlock (&fetch->lock);
+
+	return ret;
+}
+
+/*	AVIOContext seek callback, called by the decoder thread
+ */
+static int64_t fetchSeekCb (void *data, int64_t offset, int whence) {
+	BarFetch_t * const fetch = data;
+	int64_t ret;
+
+	pthread_mutex_lock (&fetch->lock);
+	whence &= ~AVSEEK_FORCE;
+	if (whence == AVSEEK_SIZE) {
+		ret = fetch->totalSize;
+	} else {
+		int64_t target = -1;
+		switch (whence) {
+			case SEEK_SET:
+				target = offset;
+				break;
+
+			case SEEK_CUR:
+				target = fetch->pos + offset;
+				break;
+
+			case SEEK_END:
+				if (fetch->totalSize >= 0) {
+					target = fetch->totalSize + offset;
+				}
+				break;
+		}
+
+		if (target < 0) {
+			ret = AVERROR (EINVAL);
+		} else if (target >= fetch->pos &&
+				target <= fetch->pos + (int64_t) fetch->len) {
+			/* forward, within buffered data */
+			fetchDrop (fetch, target - fetch->pos);
+			pthread_cond_broadcast (&fetch->cond);
+			ret = target;
+		} else {
+			fetch->seekTo = target;
+			pthread_cond_broadcast (&fetch->cond);
+			while (fetch->seekTo >= 0 && !fetch->quit) {
+				pthread_cond_wait (&fetch->cond, &fetch->lock);
+			}
+			ret = fetch->error != 0 ? fetch->error : fetch->pos;
+		}
+	}
+	pthread_mutex_unlock (&fetch->lock);
+
+	return ret;
+}
+
+void BarFetchInit (BarFetch_t * const fetch) {
+	memset (fetch, 0, sizeof (*fetch));
+	fetch->seekTo = -1;
+	fetch->totalSize = -1;
+}
+
+/*	Connect to url and start fetch thread
+ *	@param fetch context, must be initialized with BarFetchInit
+ *	@param url
+ *	@param protocol options
+ *	@param interrupt callback, may be NULL
+ *	@param ring buffer size in bytes
+ *	@return av error code
+ */
+int BarFetchOpen (BarFetch_t * const fetch, const char * const url,
+		AVDictionary **options, const AVIOInterruptCB * const cb,
+		const size_t size) {
+	assert (fetch != NULL);
+	assert (url != NULL);
+	assert (size > 0);
+	assert (!fetch->running);
+
+	if (cb != NULL) {
+		fetch->userCb = *cb;
+	}
+	fetch->intCb.callback = fetchIntCb;
+	fetch->intCb.opaque = fetch;
+	fetch->srcCb.callback = fetchSrcIntCb;
+	fetch->srcCb.opaque = fetch;
+
+	/* required for reconnecting */
+	if ((fetch->url = strdup (url)) == NULL) {
+		return AVERROR (ENOMEM);
+	}
+	if (options != NULL) {
+		av_dict_copy (&fetch->options, *options, 0);
+	}
+
+	int ret;
+	if ((ret = avio_open2 (&fetch->src, url, AVIO_FLAG_READ, &fetch->srcCb,
+			options)) < 0) {
+		BarFetchClose (fetch);
+		return ret;
+	}
+	fetch->windowStart = fetchNow ();
+	fetch->totalSize = avio_size (fetch->src);
+
+	fetch->size = size;
+	if ((fetch->buf = malloc (fetch->size)) == NULL) {
+		BarFetchClose (fetch);
+		return AVERROR (ENOMEM);
+	}
+
+	unsigned char * const iobuf = av_malloc (BAR_FETCH_IOSIZE);
+	if (iobuf == NULL || (fetch->pb = avio_alloc_context (iobuf,
+			BAR_FETCH_IOSIZE, 0, fetch, fetchRead, NULL, fetchSeekCb)) == NULL) {
+		av_free (iobuf);
+		BarFetchClose (fetch);
+		return AVERROR (ENOMEM);
+	}
+
+	pthread_mutex_init (&fetch->lock, NULL);
+	pthread_cond_init (&fetch->cond, NULL);
+	pthread_create (&fetch->thread, NULL, BarFetchThread, fetch);
+	fetch->running = true;
+
+	return 0;
+}
+
+/*	Tell the fetch thread to exit and abort pending I/O, does not block.
+ *	The interrupt callback is not called any more afterwards.
+ */
+void BarFetchStop (BarFetch_t * const fetch) {
+	assert (fetch != NULL);
+
+	if (fetch->running) {
+		pthread_mutex_lock (&fetch->lock);
+		__atomic_store_n (&fetch->quit, true, __ATOMIC_RELEASE);
+		pthread_cond_broadcast (&fetch->cond);
+		pthread_mutex_unlock (&fetch->lock);
+	}
+}
+
+/*	Stop fetch thread and free all resources. The demuxer must be closed
+ *	already.
+ */
+void BarFetchClose (BarFetch_t * const fetch) {
+	assert (fetch != NULL);
+
+	if (fetch->running) {
+		BarFetchStop (fetch);
+		pthread_join (fetch->thread, NULL);
+		pthread_cond_destroy (&fetch->cond);
+		pthread_mutex_destroy (&fetch->lock);
+	}
+	if (fetch->pb != NULL) {
+		av_freep (&fetch->pb->buffer);
+		avio_context_free (&fetch->pb);
+	}
+	if (fetch->src != NULL) {
+		avio_closep (&fetch->src);
+	}
+	free (fetch->buf);
+	free (fetch->url);
+	av_dict_free (&fetch->options);
+
+	BarFetchInit (fetch);
+}
+
+/*	Can n bytes be read without blocking?
+ */
+bool BarFetchReady (BarFetch_t * const fetch, const size_t n) {
+	pthread_mutex_lock (&fetch->lock);
+	const bool ready = fetch->len >= n || fetch->eof;
+	pthread_mutex_unlock (&fetch->lock);
+	return ready;
+}
+
+/*	Bytes downloaded, but not consumed by the decoder yet
+ */
+size_t BarFetchBuffered (BarFetch_t * const fetch) {
+	if (!fetch->running) {
+		return 0;
+	}
+	pthread_mutex_lock (&fetch->lock);
+	const size_t len = fetch->len;
+	pthread_mutex_unlock (&fetch->lock);
+	return len;
+}
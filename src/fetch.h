@@ -0,0 +1,86 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include <libavformat/avformat.h>
+
+/* network fetch stage, reads from the server at line rate into a bounded
+ * ring buffer. The demuxer consumes through a custom AVIOContext. */
+typedef struct {
+	/* ring buffer, len bytes starting at start */
+	uint8_t *buf;
+	size_t size, start, len;
+	/* stream offset of buf[start] */
+	int64_t pos;
+	/* total size of the resource, < 0 if unknown */
+	int64_t totalSize;
+	/* pending seek request, < 0 if none */
+	int64_t seekTo;
+	/* fetch thread is done, error is an av error code */
+	bool eof;
+	int error;
+	/* tells the fetch thread to exit */
+	bool quit;
+	/* download rate in kbit/s, 0 if not measured yet */
+	unsigned int throughput;
+	/* stall watchdog, set by the consumer: bytes per second the stream
+	 * needs (0 disables the watchdog) and milliseconds of audio buffered
+	 * downstream of the ring */
+	unsigned int byteRate, downstreamMs;
+
+	pthread_mutex_t lock;
+	/* broadcast on every change of the fields above */
+	pthread_cond_t cond;
+	pthread_t thread;
+	bool running;
+
+	/* network connection, fetch thread only */
+	AVIOContext *src;
+	char *url;
+	AVDictionary *options;
+	/* current throughput sample */
+	uint64_t sampleBytes, sampleNs;
+	/* watchdog window and time of last reconnect */
+	uint64_t windowStart, windowBytes, lastReconnect;
+	bool stalled;
+	/* handed to the demuxer */
+	AVIOContext *pb;
+	/* checked by both threads in addition to quit, srcCb also runs the
+	 * watchdog */
+	AVIOInterruptCB userCb, intCb, srcCb;
+} BarFetch_t;
+
+void BarFetchInit (BarFetch_t * const);
+int BarFetchOpen (BarFetch_t * const, const char * const, AVDictionary **,
+		const AVIOInterruptCB * const, const size_t);
+void BarFetchStop (BarFetch_t * const);
+void BarFetchClose (BarFetch_t * const);
+size_t BarFetchBuffered (BarFetch_t * const);
+bool BarFetchReady (BarFetch_t * const, const size_t);
@@ -0,0 +1,514 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* built-in HTTP server for listeners on other machines.
+ *
+ * /stream.wav serves the decoded audio as 16 bit WAV, /stream the
+ * compressed frames as they were downloaded (AAC with ADTS headers or MP3).
+ * The player writes each stream once into a ring buffer, every client has
+ * its own cursor into it. A client that falls behind by more than the ring
+ * skips ahead to the current position. When the format changes between
+ * tracks, clients are disconnected so they reconnect and get a new header.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "httpd.h"
+#include "debug.h"
+
+#define RING_MASK (BAR_HTTPD_RING-1)
+
+static void setFlags (const int fd) {
+	fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+	fcntl (fd, F_SETFD, FD_CLOEXEC);
+}
+
+static void wake (BarHttpd_t * const httpd) {
+	if (httpd->wakeFd[1] != -1) {
+		const char c = 0;
+		/* a full pipe is fine, the thread will wake up anyway */
+		if (write (httpd->wakeFd[1], &c, sizeof (c)) == -1) {
+			assert (errno == EAGAIN || errno == EWOULDBLOCK);
+		}
+	}
+}
+
+void BarHttpdInit (BarHttpd_t * const httpd) {
+	assert (httpd != NULL);
+
+	memset (httpd, 0, sizeof (*httpd));
+	httpd->fd = -1;
+	httpd->wakeFd[0] = httpd->wakeFd[1] = -1;
+	for (size_t i = 0; i < BAR_HTTPD_MAXCLIENTS; i++) {
+		httpd->clients[i].fd = -1;
+	}
+	pthread_mutex_init (&httpd->lock, NULL);
+	BarMixInit (&httpd->mix);
+}
+
+static void clientClose (BarHttpd_t * const httpd,
+		BarHttpdClient_t * const client) {
+	debugPrint (DEBUG_AUDIO, "httpd: closing client %i\n", client->fd);
+	if (client->streaming) {
+		pthread_mutex_lock (&httpd->lock);
+		--httpd->rings[client->stream].listeners;
+		pthread_mutex_unlock (&httpd->lock);
+	}
+	close (client->fd);
+	client->fd = -1;
+	client->reqLen = 0;
+	client->streaming = false;
+	client->outLen = client->outOff = 0;
+	client->closing = false;
+}
+
+/*	Queue a response without body and close afterwards
+ */
+static void clientError (BarHttpdClient_t * const client,
+		const char * const status) {
+	client->outLen = snprintf ((char *) client->out, sizeof (client->out),
+			"HTTP/1.0 %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+			status);
+	client->outOff = 0;
+	client->closing = true;
+}
+
+/*	Parse the request line, once the headers are complete
+ */
+static void clientRequest (BarHttpd_t * const httpd,
+		BarHttpdClient_t * const client) {
+	client->req[client->reqLen] = '\0';
+	if (strstr (client->req, "\r\n\r\n") == NULL &&
+			strstr (client->req, "\n\n") == NULL) {
+		if (client->reqLen >= sizeof (client->req) - 1) {
+			clientError (client, "400 Bad Request");
+		}
+		return;
+	}
+
+	char method[8], path[256];
+	if (sscanf (client->req, "%7s %255s", method, path) != 2 ||
+			strcmp (method, "GET") != 0) {
+		clientError (client, "400 Bad Request");
+		return;
+	}
+	char * const query = strchr (path, '?');
+	if (query != NULL) {
+		*query = '\0';
+	}
+
+	BarHttpdStream_t stream;
+	if (strcmp (path, "/stream.wav") == 0) {
+		stream = BAR_HTTPD_PCM;
+	} else if (strcmp (path, "/stream") == 0) {
+		stream = BAR_HTTPD_COMPRESSED;
+	} else {
+		clientError (client, "404 Not Found");
+		return;
+	}
+
+	pthread_mutex_lock (&httpd->lock);
+	BarHttpdRing_t * const ring = &httpd->rings[stream];
+	if (ring->headerLen == 0) {
+		pthread_mutex_unlock (&httpd->lock);
+		clientError (client, "503 Service Unavailable");
+		return;
+	}
+	memcpy (client->out, ring->header, ring->headerLen);
+	client->outLen = ring->headerLen;
+	client->outOff = 0;
+	/* start with the next sample or frame */
+	client->cursor = ring->head;
+	client->generation = ring->generation;
+	client->stream = stream;
+	client->streaming = true;
+	++ring->listeners;
+	pthread_mutex_unlock (&httpd->lock);
+	debugPrint (DEBUG_AUDIO, "httpd: client %i streams %s\n", client->fd,
+			path);
+}
+
+/*	Copy the next chunk of the stream to the client’s output buffer
+ */
+static void clientFill (BarHttpd_t * const httpd,
+		BarHttpdClient_t * const client) {
+	pthread_mutex_lock (&httpd->lock);
+	const BarHttpdRing_t * const ring = &httpd->rings[client->stream];
+	if (ring->generation != client->generation) {
+		pthread_mutex_unlock (&httpd->lock);
+		client->outLen = client->outOff = 0;
+		client->closing = true;
+		return;
+	}
+	if (ring->head - client->cursor > BAR_HTTPD_RING) {
+		debugPrint (DEBUG_AUDIO, "httpd: client %i is too slow, skipping\n",
+				client->fd);
+		client->cursor = ring->head;
+	}
+	const size_t avail = ring->head - client->cursor,
+			off = client->cursor & RING_MASK;
+	size_t n = avail < sizeof (client->out) ? avail : sizeof (client->out);
+	n = BAR_HTTPD_RING - off < n ? BAR_HTTPD_RING - off : n;
+	memcpy (client->out, &ring->data[off], n);
+	client->cursor += n;
+	pthread_mutex_unlock (&httpd->lock);
+	client->outLen = n;
+	client->outOff = 0;
+}
+
+/*	Write pending output
+ *	@return false if the client is gone
+ */
+static bool clientFlush (BarHttpd_t * const httpd,
+		BarHttpdClient_t * const client) {
+	while (true) {
+		if (client->outOff == client->outLen) {
+			if (client->closing || !client->streaming) {
+				return !client->closing;
+			}
+			clientFill (httpd, client);
+			if (client->outLen == 0) {
+				return !client->closing;
+			}
+		}
+		const ssize_t ret = write (client->fd, &client->out[client->outOff],
+				client->outLen - client->outOff);
+		if (ret > 0) {
+			client->outOff += ret;
+		} else if (ret == -1 && errno == EINTR) {
+			continue;
+		} else if (ret == -1 && errno == EAGAIN) {
+			return true;
+		} else {
+			return false;
+		}
+	}
+}
+
+static void clientAccept (BarHttpd_t * const httpd) {
+	const int fd = accept (httpd->fd, NULL, NULL);
+	if (fd == -1) {
+		return;
+	}
+	for (size_t i = 0; i < BAR_HTTPD_MAXCLIENTS; i++) {
+		BarHttpdClient_t * const client = &httpd->clients[i];
+		if (client->fd == -1) {
+			setFlags (fd);
+			client->fd = fd;
+			debugPrint (DEBUG_AUDIO, "httpd: new client %i\n", fd);
+			return;
+		}
+	}
+	/* too many clients */
+	close (fd);
+}
+
+static void *httpdThread (void *data) {
+	BarHttpd_t * const httpd = data;
+
+	while (!__atomic_load_n (&httpd->terminate, __ATOMIC_ACQUIRE)) {
+		struct pollfd pfd[BAR_HTTPD_MAXCLIENTS+2];
+		pfd[0].fd = httpd->fd;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = httpd->wakeFd[0];
+		pfd[1].events = POLLIN;
+		for (size_t i = 0; i < BAR_HTTPD_MAXCLIENTS; i++) {
+			BarHttpdClient_t * const client = &httpd->clients[i];
+			pfd[i+2].fd = client->fd;
+			/* streaming clients send nothing, but this detects hangups */
+			pfd[i+2].events = POLLIN |
+					(client->outOff < client->outLen ? POLLOUT : 0);
+		}
+
+		poll (pfd, BAR_HTTPD_MAXCLIENTS+2, -1);
+		char buf[256];
+		while (read (httpd->wakeFd[0], buf, sizeof (buf)) > 0);
+
+		if (pfd[0].revents & POLLIN) {
+			clientAccept (httpd);
+		}
+
+		for (size_t i = 0; i < BAR_HTTPD_MAXCLIENTS; i++) {
+			BarHttpdClient_t * const client = &httpd->clients[i];
+			if (client->fd == -1 || pfd[i+2].fd == -1) {
+				/* just accepted clients are handled in the next round */
+				continue;
+			}
+			if (pfd[i+2].revents & (POLLIN | POLLHUP | POLLERR)) {
+				char * const dst = client->streaming ? buf :
+						&client->req[client->reqLen];
+				const size_t len = client->streaming ? sizeof (buf) :
+						sizeof (client->req) - 1 - client->reqLen;
+				const ssize_t ret = read (client->fd, dst, len);
+				if (ret == 0 || (ret == -1 && errno != EAGAIN &&
+						errno != EINTR)) {
+					clientClose (httpd, client);
+					continue;
+				}
+				if (ret > 0 && !client->streaming && !client->closing) {
+					client->reqLen += ret;
+					clientRequest (httpd, client);
+				}
+			}
+			if (!clientFlush (httpd, client)) {
+				clientClose (httpd, client);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*	Listen on address:port and start the server thread
+ */
+bool BarHttpdOpen (BarHttpd_t * const httpd, const char * const address,
+		const unsigned int port) {
+	assert (httpd != NULL);
+	assert (address != NULL);
+
+	struct sockaddr_in addr;
+	memset (&addr, 0, sizeof (addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons (port);
+	if (inet_pton (AF_INET, address, &addr.sin_addr) != 1) {
+		errno = EINVAL;
+		return false;
+	}
+
+	for (size_t i = 0; i < BAR_HTTPD_STREAMS; i++) {
+		if ((httpd->rings[i].data = malloc (BAR_HTTPD_RING)) == NULL) {
+			return false;
+		}
+	}
+
+	if ((httpd->fd = socket (AF_INET, SOCK_STREAM, 0)) == -1) {
+		return false;
+	}
+	const int one = 1;
+	setsockopt (httpd->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+	if (bind (httpd->fd, (struct sockaddr *) &addr, sizeof (addr)) == -1 ||
+			listen (httpd->fd, BAR_HTTPD_MAXCLIENTS) == -1) {
+		close (httpd->fd);
+		httpd->fd = -1;
+		return false;
+	}
+	setFlags (httpd->fd);
+
+	if (pipe (httpd->wakeFd) == -1) {
+		httpd->wakeFd[0] = httpd->wakeFd[1] = -1;
+		return false;
+	}
+	setFlags (httpd->wakeFd[0]);
+	setFlags (httpd->wakeFd[1]);
+	if (pthread_create (&httpd->thread, NULL, httpdThread, httpd) != 0) {
+		return false;
+	}
+	httpd->running = true;
+
+	return true;
+}
+
+void BarHttpdDestroy (BarHttpd_t * const httpd) {
+	assert (httpd != NULL);
+
+	if (httpd->running) {
+		__atomic_store_n (&httpd->terminate, true, __ATOMIC_RELEASE);
+		wake (httpd);
+		pthread_join (httpd->thread, NULL);
+	}
+	for (size_t i = 0; i < BAR_HTTPD_MAXCLIENTS; i++) {
+		if (httpd->clients[i].fd != -1) {
+			close (httpd->clients[i].fd);
+		}
+	}
+	if (httpd->fd != -1) {
+		close (httpd->fd);
+	}
+	for (size_t i = 0; i < 2; i++) {
+		if (httpd->wakeFd[i] != -1) {
+			close (httpd->wakeFd[i]);
+		}
+	}
+	for (size_t i = 0; i < BAR_HTTPD_STREAMS; i++) {
+		free (httpd->rings[i].data);
+	}
+	free (httpd->pcmBuf);
+	pthread_mutex_destroy (&httpd->lock);
+	memset (httpd, 0, sizeof (*httpd));
+	httpd->fd = -1;
+}
+
+/*	Anybody listening? Writing can be skipped otherwise.
+ */
+bool BarHttpdListening (BarHttpd_t * const httpd,
+		const BarHttpdStream_t stream) {
+	if (!httpd->running) {
+		return false;
+	}
+	pthread_mutex_lock (&httpd->lock);
+	const bool ret = httpd->rings[stream].listeners > 0;
+	pthread_mutex_unlock (&httpd->lock);
+	return ret;
+}
+
+/*	Set the response header of a stream, clients are disconnected if it
+ *	changed
+ *	@param header, NULL or empty if the stream is not available
+ *	@param length, the header may contain binary data
+ */
+static void setHeader (BarHttpd_t * const httpd, const BarHttpdStream_t stream,
+		const char * const header, const size_t len) {
+	if (!httpd->running) {
+		return;
+	}
+	assert (len <= sizeof (httpd->rings[stream].header));
+
+	pthread_mutex_lock (&httpd->lock);
+	BarHttpdRing_t * const ring = &httpd->rings[stream];
+	if (ring->headerLen != len || memcmp (ring->header, header, len) != 0) {
+		memcpy (ring->header, header, len);
+		ring->headerLen = len;
+		++ring->generation;
+	}
+	pthread_mutex_unlock (&httpd->lock);
+	wake (httpd);
+}
+
+static size_t httpHeader (char * const dst, const size_t size,
+		const char * const contentType) {
+	return snprintf (dst, size, "HTTP/1.0 200 OK\r\nContent-Type: %s\r\n"
+			"Cache-Control: no-cache\r\nConnection: close\r\n\r\n",
+			contentType);
+}
+
+/*	Format of the compressed stream
+ *	@param MIME type or NULL if the codec cannot be streamed
+ */
+void BarHttpdFormat (BarHttpd_t * const httpd, const BarHttpdStream_t stream,
+		const char * const contentType) {
+	char header[256];
+	size_t len = 0;
+	if (contentType != NULL) {
+		len = httpHeader (header, sizeof (header), contentType);
+	}
+	setHeader (httpd, stream, header, len);
+}
+
+static void putLe (char * const dst, const uint32_t v, const size_t bytes) {
+	for (size_t i = 0; i < bytes; i++) {
+		dst[i] = (v >> (8*i)) & 0xff;
+	}
+}
+
+/*	Format of the PCM stream, WAV with unknown length
+ */
+void BarHttpdPcmFormat (BarHttpd_t * const httpd, const unsigned int rate,
+		const unsigned int channels) {
+	httpd->channels = channels;
+
+	char header[512];
+	size_t len = httpHeader (header, sizeof (header) - 44, "audio/wav");
+	char * const wav = &header[len];
+	const unsigned int blockAlign = channels * sizeof (int16_t);
+	memcpy (&wav[0], "RIFF", 4);
+	putLe (&wav[4], 0xffffffff, 4);
+	memcpy (&wav[8], "WAVEfmt ", 8);
+	putLe (&wav[16], 16, 4);
+	/* integer PCM */
+	putLe (&wav[20], 1, 2);
+	putLe (&wav[22], channels, 2);
+	putLe (&wav[24], rate, 4);
+	putLe (&wav[28], rate * blockAlign, 4);
+	putLe (&wav[32], blockAlign, 2);
+	putLe (&wav[34], 16, 2);
+	memcpy (&wav[36], "data", 4);
+	putLe (&wav[40], 0xffffffff, 4);
+	len += 44;
+	setHeader (httpd, BAR_HTTPD_PCM, header, len);
+}
+
+/*	Append to a stream, prefix and data are written back to back
+ */
+void BarHttpdWrite (BarHttpd_t * const httpd, const BarHttpdStream_t stream,
+		const void * const prefix, const size_t prefixLen,
+		const void * const data, const size_t len) {
+	if (!httpd->running) {
+		return;
+	}
+
+	pthread_mutex_lock (&httpd->lock);
+	BarHttpdRing_t * const ring = &httpd->rings[stream];
+	const void * const parts[2] = {prefix, data};
+	const size_t lens[2] = {prefixLen, len};
+	for (size_t i = 0; i < 2; i++) {
+		const uint8_t *src = parts[i];
+		size_t left = lens[i];
+		while (left > 0) {
+			const size_t off = ring->head & RING_MASK,
+					n = BAR_HTTPD_RING - off < left ? BAR_HTTPD_RING - off : left;
+			memcpy (&ring->data[off], src, n);
+			ring->head += n;
+			src += n;
+			left -= n;
+		}
+	}
+	pthread_mutex_unlock (&httpd->lock);
+	wake (httpd);
+}
+
+/*	Append planar float samples to the PCM stream, as S16 little endian
+ */
+void BarHttpdPcm (BarHttpd_t * const httpd, const float * const * const planes,
+		const size_t samples) {
+	const size_t len = samples * httpd->channels * sizeof (int16_t);
+	if (len > httpd->pcmBufSize) {
+		uint8_t * const buf = realloc (httpd->pcmBuf, len);
+		if (buf == NULL) {
+			return;
+		}
+		httpd->pcmBuf = buf;
+		httpd->pcmBufSize = len;
+	}
+	BarMixConvert (&httpd->mix, httpd->pcmBuf, BAR_MIX_S16, planes,
+			httpd->channels, samples, 1, false);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	for (size_t i = 0; i < len; i += 2) {
+		const uint8_t t = httpd->pcmBuf[i];
+		httpd->pcmBuf[i] = httpd->pcmBuf[i+1];
+		httpd->pcmBuf[i+1] = t;
+	}
+#endif
+	BarHttpdWrite (httpd, BAR_HTTPD_PCM, NULL, 0, httpd->pcmBuf, len);
+}
@@ -0,0 +1,106 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "mix.h"
+
+#define BAR_HTTPD_MAXCLIENTS 16
+/* per-stream history in bytes, power of two */
+#define BAR_HTTPD_RING (4*1024*1024)
+
+typedef enum {
+	/* decoded audio as WAV, /stream.wav */
+	BAR_HTTPD_PCM = 0,
+	/* the original compressed frames, /stream */
+	BAR_HTTPD_COMPRESSED,
+	BAR_HTTPD_STREAMS,
+} BarHttpdStream_t;
+
+/* shared by all clients of a stream, written by the player */
+typedef struct {
+	uint8_t *data;
+	/* free-running write position */
+	uint64_t head;
+	/* incremented when the format changes, clients of an older one are
+	 * disconnected */
+	unsigned int generation;
+	/* response header for new clients, empty if the stream is unavailable */
+	char header[512];
+	size_t headerLen;
+	/* number of clients */
+	unsigned int listeners;
+} BarHttpdRing_t;
+
+typedef struct {
+	int fd;
+	/* request, until the empty line */
+	char req[1024];
+	size_t reqLen;
+	bool streaming;
+	BarHttpdStream_t stream;
+	unsigned int generation;
+	/* read position in the stream’s ring */
+	uint64_t cursor;
+	/* pending output, copied from the ring so it can be written without
+	 * holding the lock */
+	uint8_t out[16384];
+	size_t outLen, outOff;
+	/* close after out was written */
+	bool closing;
+} BarHttpdClient_t;
+
+typedef struct {
+	/* listening socket, -1 if disabled */
+	int fd;
+	BarHttpdClient_t clients[BAR_HTTPD_MAXCLIENTS];
+	/* protects rings */
+	pthread_mutex_t lock;
+	BarHttpdRing_t rings[BAR_HTTPD_STREAMS];
+	int wakeFd[2];
+	pthread_t thread;
+	bool running, terminate;
+	/* PCM conversion, player only */
+	BarMix_t mix;
+	uint8_t *pcmBuf;
+	size_t pcmBufSize;
+	unsigned int channels;
+} BarHttpd_t;
+
+void BarHttpdInit (BarHttpd_t * const);
+bool BarHttpdOpen (BarHttpd_t * const, const char * const, const unsigned int);
+void BarHttpdDestroy (BarHttpd_t * const);
+bool BarHttpdListening (BarHttpd_t * const, const BarHttpdStream_t);
+void BarHttpdFormat (BarHttpd_t * const, const BarHttpdStream_t,
+		const char * const);
+void BarHttpdPcmFormat (BarHttpd_t * const, const unsigned int,
+		const unsigned int);
+void BarHttpdWrite (BarHttpd_t * const, const BarHttpdStream_t,
+		const void * const, const size_t, const void * const, const size_t);
+void BarHttpdPcm (BarHttpd_t * const, const float * const * const,
+		const size_t);
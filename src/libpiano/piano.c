@@ -126,6 +126,9 @@ void PianoDestroyPlaylist (PianoSong_t *playlist) {
 	curSong = playlist;
 	while (curSong != NULL) {
 		free (curSong->audioUrl);
+		for (size_t i = 0; i < sizeof (curSong->audio)/sizeof (*curSong->audio); i++) {
+			free (curSong->audio[i].url);
+		}
 		free (curSong->coverArt);
 		free (curSong->artist);
 		free (curSong->musicId);
@@ -83,6 +83,13 @@ typedef enum {
 	PIANO_AQ_HIGH = 3,
 } PianoAudioQuality_t;
 
+typedef struct {
+	char *url;
+	PianoAudioFormat_t format;
+	/* kbit/s, 0 if unknown */
+	unsigned int bitrate;
+} PianoAudioUrl_t;
+
 typedef struct PianoSong {
 	PianoListHead_t head;
 	char *artist;
@@ -100,6 +107,9 @@ typedef struct PianoSong {
 	unsigned int length; /* song length in seconds */
 	PianoSongRating_t rating;
 	PianoAudioFormat_t audioFormat;
+	/* all available qualities, indexed by PianoAudioQuality_t. audioUrl and
+	 * audioFormat are a copy of the requested one */
+	PianoAudioUrl_t audio[PIANO_AQ_HIGH+1];
 } PianoSong_t;
 
 /* currently only used for search results */
@@ -208,6 +218,7 @@ typedef struct {
 
 typedef struct {
 	PianoStation_t *station;
+	/* PIANO_AQ_UNKNOWN selects the best quality available */
 	PianoAudioQuality_t quality;
 	PianoSong_t *retPlaylist;
 } PianoRequestDataGetPlaylist_t;
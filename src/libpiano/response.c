@@ -248,7 +248,6 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 
 			assert (req->responseData != NULL);
 			assert (reqData != NULL);
-			assert (reqData->quality != PIANO_AQ_UNKNOWN);
 
 			json_object *items = NULL;
 			if (!json_object_object_get_ex (result, "items", &items)) {
@@ -269,7 +268,7 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 					continue;
 				}
 
-				/* get audio url based on selected quality */
+				/* get audio urls for all qualities */
 				static const char *qualityMap[] = {"", "lowQuality", "mediumQuality",
 						"highQuality"};
 				assert (reqData->quality < sizeof (qualityMap)/sizeof (*qualityMap));
@@ -278,22 +277,43 @@ PianoReturn_t PianoResponse (PianoHandle_t *ph, PianoRequest_t *req) {
 				json_object *umap;
 				if (json_object_object_get_ex (s, "audioUrlMap", &umap)) {
 					assert (umap != NULL);
-					json_object *jsonEncoding, *qmap;
-					if (json_object_object_get_ex (umap, qualityMap[reqData->quality], &qmap) &&
-							json_object_object_get_ex (qmap, "encoding", &jsonEncoding)) {
+					for (size_t q = PIANO_AQ_LOW; q < sizeof (qualityMap)/sizeof (*qualityMap); q++) {
+						json_object *jsonEncoding, *qmap, *v;
+						if (!json_object_object_get_ex (umap, qualityMap[q], &qmap) ||
+								!json_object_object_get_ex (qmap, "encoding", &jsonEncoding)) {
+							continue;
+						}
 						assert (qmap != NULL);
+						PianoAudioUrl_t * const audio = &song->audio[q];
 						const char *encoding = json_object_get_string (jsonEncoding);
 						assert (encoding != NULL);
 						for (size_t k = 0; k < sizeof (formatMap)/sizeof (*formatMap); k++) {
 							if (strcmp (formatMap[k], encoding) == 0) {
-								song->audioFormat = k;
+								audio->format = k;
 								break;
 							}
 						}
-						song->audioUrl = PianoJsonStrdup (qmap, "audioUrl");
+						audio->url = PianoJsonStrdup (qmap, "audioUrl");
+						/* a string, which json-c converts for us */
+						audio->bitrate = json_object_object_get_ex (qmap, "bitrate", &v) ?
+								json_object_get_int (v) : 0;
+					}
+
+					/* unknown quality selects the best one available */
+					size_t q = reqData->quality;
+					if (q == PIANO_AQ_UNKNOWN) {
+						for (q = PIANO_AQ_HIGH; q > PIANO_AQ_UNKNOWN &&
+								song->audio[q].url == NULL; q--);
+					}
+					if (song->audio[q].url != NULL) {
+						song->audioUrl = strdup (song->audio[q].url);
+						song->audioFormat = song->audio[q].format;
 					} else {
 						/* requested quality is not available */
 						ret = PIANO_RET_QUALITY_UNAVAILABLE;
+						for (size_t i = 0; i < sizeof (song->audio)/sizeof (*song->audio); i++) {
+							free (song->audio[i].url);
+						}
 						free (song);
 						PianoDestroyPlaylist (playlist);
 						goto cleanup;
@@ -29,7 +29,7 @@ THE SOFTWARE.
 #include <stdio.h>
 /* fork () */
 #include <unistd.h>
-#include <sys/select.h>
+#include <poll.h>
 #include <time.h>
 #include <ctype.h>
 /* open () */
@@ -56,6 +56,7 @@ THE SOFTWARE.
 #include "ui.h"
 #include "ui_dispatch.h"
 #include "ui_readline.h"
+#include "remote.h"
 
 /*	authenticate user
  */
@@ -71,7 +72,7 @@ static bool BarMainLoginUser (BarApp_t *app) {
 
 	BarUiMsg (&app->settings, MSG_INFO, "Login... ");
 	ret = BarUiPianoCall (app, PIANO_REQUEST_LOGIN, &reqData, &pRet, &wRet);
-	BarUiStartEventCmd (&app->settings, "userlogin", NULL, NULL, &app->player,
+	BarUiStartEventCmd (app, "userlogin", NULL, NULL, &app->player,
 			NULL, pRet, wRet);
 
 	return ret;
@@ -173,7 +174,7 @@ static bool BarMainGetStations (BarApp_t *app) {
 
 	BarUiMsg (&app->settings, MSG_INFO, "Get stations... ");
 	ret = BarUiPianoCall (app, PIANO_REQUEST_GET_STATIONS, NULL, &pRet, &wRet);
-	BarUiStartEventCmd (&app->settings, "usergetstations", NULL, NULL, &app->player,
+	BarUiStartEventCmd (app, "usergetstations", NULL, NULL, &app->player,
 			app->ph.stations, pRet, wRet);
 	return ret;
 }
@@ -197,17 +198,65 @@ static void BarMainGetInitialStation (BarApp_t *app) {
 	}
 }
 
-/*	wait for user input
+/*	handle pending user input
  */
 static void BarMainHandleUserInput (BarApp_t *app) {
 	char buf[2];
 	if (BarReadline (buf, sizeof (buf), NULL, &app->input,
-			BAR_RL_FULLRETURN | BAR_RL_NOECHO | BAR_RL_NOINT, 1) > 0) {
+			BAR_RL_FULLRETURN | BAR_RL_NOECHO | BAR_RL_NOINT, 0) > 0) {
 		BarUiDispatch (app, buf[0], app->curStation, app->playlist, true,
 				BAR_DC_GLOBAL);
 	}
 }
 
+/*	wait for user input, player state changes or timeout
+ *	@param timeout in milliseconds or -1
+ *	@return true if user input was handled
+ */
+static bool BarMainWait (BarApp_t *app, const int timeout) {
+	player_t * const player = &app->player;
+	struct pollfd fds[3 + BAR_REMOTE_MAXFDS];
+	const size_t inputFds = sizeof (app->input.fds) / sizeof (*app->input.fds);
+
+	assert (inputFds + 1 + BAR_REMOTE_MAXFDS == sizeof (fds) / sizeof (*fds));
+	memcpy (fds, app->input.fds, sizeof (app->input.fds));
+	fds[inputFds].fd = player->notifyFd[0];
+	fds[inputFds].events = POLLIN;
+	const size_t remoteFds = BarRemotePollFds (&app->remote, &fds[inputFds+1]);
+
+	/* buffered commands are handled without waiting */
+	const bool pending = BarReadlinePending (&app->input);
+	if (poll (fds, inputFds + 1 + remoteFds, pending ? 0 : timeout) < 0) {
+		/* interrupted */
+		return false;
+	}
+
+	if (fds[inputFds].revents != 0) {
+		BarPlayerClearNotify (player);
+	}
+
+	BarRemoteHandle (app, &fds[inputFds+1], remoteFds);
+
+	bool haveInput = pending;
+	for (size_t i = 0; i < inputFds; i++) {
+		haveInput = haveInput || fds[i].revents != 0;
+	}
+	if (haveInput) {
+		BarMainHandleUserInput (app);
+	}
+	return haveInput;
+}
+
+/*	milliseconds until deadline, 0 if it passed already
+ */
+static int BarMainTimeUntil (const struct timespec * const deadline) {
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	const long long diff = (deadline->tv_sec - now.tv_sec) * 1000LL +
+			(deadline->tv_nsec - now.tv_nsec) / 1000000;
+	return diff > 0 ? diff : 0;
+}
+
 /*	fetch new playlist
  */
 static void BarMainGetPlaylist (BarApp_t *app) {
@@ -229,16 +278,15 @@ static void BarMainGetPlaylist (BarApp_t *app) {
 		}
 	}
 	app->curStation = app->nextStation;
-	BarUiStartEventCmd (&app->settings, "stationfetchplaylist",
+	BarUiStartEventCmd (app, "stationfetchplaylist",
 			app->curStation, app->playlist, &app->player, app->ph.stations,
 			pRet, wRet);
 }
 
 /*	start new player thread
  */
-static void BarMainStartPlayback (BarApp_t *app, pthread_t *playerThread) {
+static void BarMainStartPlayback (BarApp_t *app) {
 	assert (app != NULL);
-	assert (playerThread != NULL);
 
 	const PianoSong_t * const curSong = app->playlist;
 	assert (curSong != NULL);
@@ -254,45 +302,41 @@ static void BarMainStartPlayback (BarApp_t *app, pthread_t *playerThread) {
 		BarUiMsg (&app->settings, MSG_ERR, "Invalid song url.\n");
 	} else {
 		player_t * const player = &app->player;
-		BarPlayerReset (player);
 
-		app->player.url = curSong->audioUrl;
-		app->player.gain = curSong->fileGain;
-		app->player.songDuration = curSong->length;
+		BarPlayerJob_t job;
+		BarPlayerSelectAudio (player, &job, curSong);
+		job.gain = curSong->fileGain;
+		BarPlayerStore (player->songDuration, curSong->length);
 
 		assert (interrupted == &app->doQuit);
 		interrupted = &app->player.interrupted;
 
 		/* throw event */
-		BarUiStartEventCmd (&app->settings, "songstart",
+		BarUiStartEventCmd (app, "songstart",
 				app->curStation, curSong, &app->player, app->ph.stations,
 				PIANO_RET_OK, CURLE_OK);
 
 		/* prevent race condition, mode must _not_ be DEAD if
-		 * thread has been started */
-		app->player.mode = PLAYER_WAITING;
-		/* start player */
-		pthread_create (playerThread, NULL, BarPlayerThread,
-				&app->player);
+		 * the job has been submitted */
+		BarPlayerStore (player->mode, PLAYER_WAITING);
+		/* start player, the queue is empty while nothing is playing */
+		const bool submitted = BarPlayerSubmit (player, &job);
+		assert (submitted);
+		(void) submitted;
 	}
 }
 
 /*	player is done, clean up
  */
-static void BarMainPlayerCleanup (BarApp_t *app, pthread_t *playerThread) {
-	void *threadRet;
-
-	BarUiStartEventCmd (&app->settings, "songfinish", app->curStation,
+static void BarMainPlayerCleanup (BarApp_t *app) {
+	BarUiStartEventCmd (app, "songfinish", app->curStation,
 			app->playlist, &app->player, app->ph.stations, PIANO_RET_OK,
 			CURLE_OK);
 
-	/* FIXME: pthread_join blocks everything if network connection
-	 * is hung up e.g. */
-	pthread_join (*playerThread, &threadRet);
-
-	if (threadRet == (void *) PLAYER_RET_OK) {
+	const int result = BarPlayerLoad (app->player.result);
+	if (result == PLAYER_RET_OK) {
 		app->playerErrors = 0;
-	} else if (threadRet == (void *) PLAYER_RET_SOFTFAIL) {
+	} else if (result == PLAYER_RET_SOFTFAIL) {
 		++app->playerErrors;
 		if (app->playerErrors >= app->settings.maxRetry) {
 			/* don't continue playback if thread reports too many error */
@@ -305,7 +349,7 @@ static void BarMainPlayerCleanup (BarApp_t *app, pthread_t *playerThread) {
 	assert (interrupted == &app->player.interrupted);
 	interrupted = &app->doQuit;
 
-	app->player.mode = PLAYER_DEAD;
+	BarPlayerStore (app->player.mode, PLAYER_DEAD);
 }
 
 /*	print song duration
@@ -315,10 +359,8 @@ static void BarMainPrintTime (BarApp_t *app) {
 	char sign[2] = {0, 0};
 	player_t * const player = &app->player;
 
-	pthread_mutex_lock (&player->lock);
-	const unsigned int songDuration = player->songDuration;
-	const unsigned int songPlayed = player->songPlayed;
-	pthread_mutex_unlock (&player->lock);
+	const unsigned int songDuration = BarPlayerLoad (player->songDuration);
+	const unsigned int songPlayed = BarPlayerGetPositionMs (player) / 1000;
 
 	if (songPlayed <= songDuration) {
 		songRemaining = songDuration - songPlayed;
@@ -347,8 +389,6 @@ static void BarMainPrintTime (BarApp_t *app) {
 /*	main loop
  */
 static void BarMainLoop (BarApp_t *app) {
-	pthread_t playerThread;
-
 	if (!BarMainGetLoginCredentials (&app->settings, &app->input)) {
 		return;
 	}
@@ -364,6 +404,9 @@ static void BarMainLoop (BarApp_t *app) {
 	BarMainGetInitialStation (app);
 
 	player_t * const player = &app->player;
+	/* next time display update, only valid while ticking */
+	struct timespec nextTick;
+	bool ticking = false;
 
 	while (!app->doQuit) {
 		/* song finished playing, clean up things/scrobble song */
@@ -371,7 +414,7 @@ static void BarMainLoop (BarApp_t *app) {
 			if (player->interrupted != 0) {
 				app->doQuit = 1;
 			}
-			BarMainPlayerCleanup (app, &playerThread);
+			BarMainPlayerCleanup (app);
 		}
 
 		/* check whether player finished playing and start playing new
@@ -392,20 +435,42 @@ static void BarMainLoop (BarApp_t *app) {
 			}
 			/* song ready to play */
 			if (app->playlist != NULL) {
-				BarMainStartPlayback (app, &playerThread);
+				BarMainStartPlayback (app);
 			}
 		}
 
-		BarMainHandleUserInput (app);
+		/* show time once per second; sleep until something happens if
+		 * nothing is playing */
+		int timeout = -1;
+		if (BarPlayerGetMode (player) == PLAYER_PLAYING &&
+				!BarPlayerLoad (player->doPause)) {
+			if (!ticking || BarMainTimeUntil (&nextTick) == 0) {
+				BarMainPrintTime (app);
+				/* when the next second of the song begins */
+				const long wait = 1000 - BarPlayerGetPositionMs (player) % 1000;
+				clock_gettime (CLOCK_MONOTONIC, &nextTick);
+				nextTick.tv_nsec += wait * 1000000L;
+				if (nextTick.tv_nsec >= 1000000000L) {
+					nextTick.tv_nsec -= 1000000000L;
+					++nextTick.tv_sec;
+				}
+				ticking = true;
+			}
+			timeout = BarMainTimeUntil (&nextTick);
+		} else {
+			ticking = false;
+		}
 
-		/* show time */
-		if (BarPlayerGetMode (player) == PLAYER_PLAYING) {
-			BarMainPrintTime (app);
+		BarRemoteUpdate (app);
+		const int remoteTimeout = BarRemoteTimeout (app);
+		if (remoteTimeout != -1 && (timeout == -1 || remoteTimeout < timeout)) {
+			timeout = remoteTimeout;
 		}
-	}
 
-	if (BarPlayerGetMode (player) != PLAYER_DEAD) {
-		pthread_join (playerThread, NULL);
+		if (BarMainWait (app, timeout)) {
+			/* redraw time after handling user input */
+			ticking = false;
+		}
 	}
 }
 
@@ -446,11 +511,13 @@ int main (int argc, char **argv) {
 	gcry_check_version (NULL);
 	gcry_control (GCRYCTL_DISABLE_SECMEM, 0);
 	gcry_control (GCRYCTL_INITIALIZATION_FINISHED, 0);
-	BarPlayerInit (&app.player, &app.settings);
 
 	BarSettingsInit (&app.settings);
 	BarSettingsRead (&app.settings);
 
+	/* starts the workers, which use the settings right away */
+	BarPlayerInit (&app.player, &app.settings);
+
 	PianoReturn_t pret;
 	if ((pret = PianoInit (&app.ph, app.settings.partnerUser,
 			app.settings.partnerPassword, app.settings.device,
@@ -475,36 +542,59 @@ int main (int argc, char **argv) {
 	assert (app.http != NULL);
 
 	/* init fds */
-	FD_ZERO(&app.input.set);
-	app.input.fds[0] = STDIN_FILENO;
-	FD_SET(app.input.fds[0], &app.input.set);
+	BarReadlineInit (&app.input);
 
 	/* open fifo read/write so it won't EOF if nobody writes to it */
 	assert (sizeof (app.input.fds) / sizeof (*app.input.fds) >= 2);
-	app.input.fds[1] = open (app.settings.fifo, O_RDWR);
-	if (app.input.fds[1] != -1) {
+	app.input.fds[1].fd = open (app.settings.fifo, O_RDWR);
+	if (app.input.fds[1].fd != -1) {
 		struct stat s;
 
 		/* check for file type, must be fifo */
-		fstat (app.input.fds[1], &s);
+		fstat (app.input.fds[1].fd, &s);
 		if (!S_ISFIFO (s.st_mode)) {
 			BarUiMsg (&app.settings, MSG_ERR, "File at %s is not a fifo\n", app.settings.fifo);
-			close (app.input.fds[1]);
-			app.input.fds[1] = -1;
+			close (app.input.fds[1].fd);
+			app.input.fds[1].fd = -1;
 		} else {
-			FD_SET(app.input.fds[1], &app.input.set);
 			BarUiMsg (&app.settings, MSG_INFO, "Control fifo at %s opened\n",
 					app.settings.fifo);
 		}
 	}
-	app.input.maxfd = app.input.fds[0] > app.input.fds[1] ? app.input.fds[0] :
-			app.input.fds[1];
-	++app.input.maxfd;
+
+	BarRemoteInit (&app.remote);
+	if (app.settings.controlSocket != NULL) {
+		if (BarRemoteOpen (&app.remote, app.settings.controlSocket)) {
+			BarUiMsg (&app.settings, MSG_INFO, "Control socket at %s opened\n",
+					app.settings.controlSocket);
+		} else {
+			BarUiMsg (&app.settings, MSG_ERR, "Cannot open control socket at "
+					"%s (%s)\n", app.settings.controlSocket, strerror (errno));
+		}
+	}
+
+	BarHttpdInit (&app.httpd);
+	if (app.settings.httpPort != 0) {
+		if (BarHttpdOpen (&app.httpd, app.settings.httpAddress,
+				app.settings.httpPort)) {
+			BarUiMsg (&app.settings, MSG_INFO, "Streaming at http://%s:%u/\n",
+					app.settings.httpAddress, app.settings.httpPort);
+			app.player.httpd = &app.httpd;
+		} else {
+			BarUiMsg (&app.settings, MSG_ERR, "Cannot listen at %s:%u (%s)\n",
+					app.settings.httpAddress, app.settings.httpPort,
+					strerror (errno));
+		}
+	}
 
 	BarMainLoop (&app);
 
-	if (app.input.fds[1] != -1) {
-		close (app.input.fds[1]);
+	/* stops the current track, which refers to the playlist freed below */
+	BarPlayerDestroy (&app.player);
+	BarRemoteDestroy (&app.remote);
+	BarHttpdDestroy (&app.httpd);
+	if (app.input.fds[1].fd != -1) {
+		close (app.input.fds[1].fd);
 	}
 
 	/* write statefile */
@@ -515,7 +605,6 @@ int main (int argc, char **argv) {
 	PianoDestroyPlaylist (app.playlist);
 	curl_easy_cleanup (app.http);
 	curl_global_cleanup ();
-	BarPlayerDestroy (&app.player);
 	BarSettingsDestroy (&app.settings);
 
 	/* restore terminal attributes, zsh doesn't need this, bash does... */
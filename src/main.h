@@ -30,8 +30,9 @@ THE SOFTWARE.
 #include "player.h"
 #include "settings.h"
 #include "ui_readline.h"
+#include "remote.h"
 
-typedef struct {
+typedef struct BarApp {
 	PianoHandle_t ph;
 	CURL *http;
 	player_t player;
@@ -44,6 +45,8 @@ typedef struct {
 	PianoStation_t *curStation, *nextStation;
 	sig_atomic_t doQuit;
 	BarReadlineFds_t input;
+	BarRemote_t remote;
+	BarHttpd_t httpd;
 	unsigned int playerErrors;
 } BarApp_t;
 
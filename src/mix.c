@@ -0,0 +1,538 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* sample format conversion and mixing.
+ *
+ * Converts planar float samples, as produced by the decoders, to
+ * interleaved signed 16 or 32 bit integers or floats for the audio device.
+ * Volume and dither are applied in the same pass. There are kernels for
+ * SSE2, AVX2 (S16 only, selected at runtime) and NEON, the scalar ones
+ * handle everything else and the tails.
+ *
+ * BarMixFade mixes two planes with gain ramps, for crossfading.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_MIX_AVX2
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "mix.h"
+
+/* used instead of the noise table if dither is disabled */
+static const float silence[2*BAR_MIX_NOISE];
+
+static uint32_t xorshift (uint32_t x) {
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+static void toS16Scalar (void * const out, const float * const * const src,
+		const size_t channels, const size_t samples, const float scale,
+		const float * const noise) {
+	int16_t * const dst = out;
+	size_t j = 0;
+	for (size_t i = 0; i < samples; i++) {
+		for (size_t c = 0; c < channels; c++) {
+			float v = src[c][i] * scale + noise[j];
+			v = v > 32767.0f ? 32767.0f : (v < -32768.0f ? -32768.0f : v);
+			dst[j++] = lrintf (v);
+		}
+	}
+}
+
+static void toS32Scalar (void * const out, const float * const * const src,
+		const size_t channels, const size_t samples, const float scale,
+		const float * const noise) {
+	int32_t * const dst = out;
+	size_t j = 0;
+	(void) noise;
+	for (size_t i = 0; i < samples; i++) {
+		for (size_t c = 0; c < channels; c++) {
+			float v = src[c][i] * scale;
+			/* largest float below 2^31 */
+			v = v > 2147483520.0f ? 2147483520.0f :
+					(v < -2147483648.0f ? -2147483648.0f : v);
+			dst[j++] = lrintf (v);
+		}
+	}
+}
+
+/* no clipping, values outside [-1,1] are passed on */
+static void toF32Scalar (void * const out, const float * const * const src,
+		const size_t channels, const size_t samples, const float scale,
+		const float * const noise) {
+	float * const dst = out;
+	size_t j = 0;
+	(void) noise;
+	for (size_t i = 0; i < samples; i++) {
+		for (size_t c = 0; c < channels; c++) {
+			dst[j++] = src[c][i] * scale;
+		}
+	}
+}
+
+/*	Convert the remaining mono/stereo samples starting at i
+ *	@param scalar kernel
+ *	@param bytes per output value
+ */
+static void convertTail (const BarMixKernel_t scalar, void * const dst,
+		const size_t size, const float * const * const src,
+		const size_t channels, const size_t samples, const float scale,
+		const float * const noise, const size_t i) {
+	if (i < samples) {
+		const float *tail[2] = {src[0] + i, channels > 1 ? src[1] + i : NULL};
+		scalar ((uint8_t *) dst + i*channels*size, tail, channels, samples - i,
+				scale, &noise[i*channels]);
+	}
+}
+
+#if defined(__SSE2__)
+static void toS16Sse2 (void * const out, const float * const * const src,
+		const size_t channels, const size_t samples, const float scale,
+		const float * const noise) {
+	int16_t * const dst = out;
+	const __m128 s = _mm_set1_ps (scale), max = _mm_set1_ps (32767.0f),
+			min = _mm_set1_ps (-32768.0f);
+	size_t i = 0;
+
+	if (channels == 2) {
+		const float * const l = src[0], * const r = src[1];
+		for (; i + 4 <= samples; i += 4) {
+			const __m128 vl = _mm_mul_ps (_mm_loadu_ps (&l[i]), s),
+					vr = _mm_mul_ps (_mm_loadu_ps (&r[i]), s);
+			/* interleave */
+			__m128 a = _mm_add_ps (_mm_unpacklo_ps (vl, vr),
+					_mm_loadu_ps (&noise[2*i]));
+			__m128 b = _mm_add_ps (_mm_unpackhi_ps (vl, vr),
+					_mm_loadu_ps (&noise[2*i+4]));
+			a = _mm_max_ps (_mm_min_ps (a, max), min);
+			b = _mm_max_ps (_mm_min_ps (b, max), min);
+			_mm_storeu_si128 ((__m128i *) &dst[2*i],
+					_mm_packs_epi32 (_mm_cvtps_epi32 (a), _mm_cvtps_epi32 (b)));
+		}
+	} else if (channels == 1) {
+		const float * const m = src[0];
+		for (; i + 8 <= samples; i += 8) {
+			__m128 a = _mm_add_ps (_mm_mul_ps (_mm_loadu_ps (&m[i]), s),
+					_mm_loadu_ps (&noise[i]));
+			__m128 b = _mm_add_ps (_mm_mul_ps (_mm_loadu_ps (&m[i+4]), s),
+					_mm_loadu_ps (&noise[i+4]));
+			a = _mm_max_ps (_mm_min_ps (a, max), min);
+			b = _mm_max_ps (_mm_min_ps (b, max), min);
+			_mm_storeu_si128 ((__m128i *) &dst[i],
+					_mm_packs_epi32 (_mm_cvtps_epi32 (a), _mm_cvtps_epi32 (b)));
+		}
+	} else {
+		toS16Scalar (dst, src, channels, samples, scale, noise);
+		return;
+	}
+	convertTail (toS16Scalar, dst, sizeof (*dst), src, channels, samples, scale,
+			noise, i);
+}
+
+static void toS32Sse2 (void * const out, const float * const * const src,
+		const size_t channels, const size_t samples, const float scale,
+		const float * const noise) {
+	int32_t * const dst = out;
+	const __m128 s = _mm_set1_ps (scale), max = _mm_set1_ps (2147483520.0f),
+			min = _mm_set1_ps (-2147483648.0f);
+	size_t i = 0;
+
+	if (channels == 2) {
+		const float * const l = src[0], * const r = src[1];
+		for (; i + 4 <= samples; i += 4) {
+			const __m128 vl = _mm_mul_ps (_mm_loadu_ps (&l[i]), s),
+					vr = _mm_mul_ps (_mm_loadu_ps (&r[i]), s);
+			const __m128 a = _mm_max_ps (_mm_min_ps (
+					_mm_unpacklo_ps (vl, vr), max), min),
+					b = _mm_max_ps (_mm_min_ps (
+					_mm_unpackhi_ps (vl, vr), max), min);
+			_mm_storeu_si128 ((__m128i *) &dst[2*i], _mm_cvtps_epi32 (a));
+			_mm_storeu_si128 ((__m128i *) &dst[2*i+4], _mm_cvtps_epi32 (b));
+		}
+	} else if (channels == 1) {
+		const float * const m = src[0];
+		for (; i + 4 <= samples; i += 4) {
+			const __m128 a = _mm_max_ps (_mm_min_ps (
+					_mm_mul_ps (_mm_loadu_ps (&m[i]), s), max), min);
+			_mm_storeu_si128 ((__m128i *) &dst[i], _mm_cvtps_epi32 (a));
+		}
+	} else {
+		toS32Scalar (dst, src, channels, samples, scale, noise);
+		return;
+	}
+	convertTail (toS32Scalar, dst, sizeof (*dst), src, channels, samples, scale,
+			noise, i);
+}
+
+static void toF32Sse2 (void * const out, const float * const * const src,
+		const size_t channels, const size_t samples, const float scale,
+		const float * const noise) {
+	float * const dst = out;
+	const __m128 s = _mm_set1_ps (scale);
+	size_t i = 0;
+
+	if (channels == 2) {
+		const float * const l = src[0], * const r = src[1];
+		for (; i + 4 <= samples; i += 4) {
+			const __m128 vl = _mm_mul_ps (_mm_loadu_ps (&l[i]), s),
+					vr = _mm_mul_ps (_mm_loadu_ps (&r[i]), s);
+			_mm_storeu_ps (&dst[2*i], _mm_unpacklo_ps (vl, vr));
+			_mm_storeu_ps (&dst[2*i+4], _mm_unpackhi_ps (vl, vr));
+		}
+	} else if (channels == 1) {
+		const float * const m = src[0];
+		for (; i + 4 <= samples; i += 4) {
+			_mm_storeu_ps (&dst[i], _mm_mul_ps (_mm_loadu_ps (&m[i]), s));
+		}
+	} else {
+		toF32Scalar (dst, src, channels, samples, scale, noise);
+		return;
+	}
+	convertTail (toF32Scalar, dst, sizeof (*dst), src, channels, samples, scale,
+			noise, i);
+}
+#endif
+
+#ifdef HAVE_MIX_AVX2
+__attribute__ ((target ("avx2")))
+static void toS16Avx2 (void * const out, const float * const * const src,
+		const size_t channels, const size_t samples, const float scale,
+		const float * const noise) {
+	int16_t * const dst = out;
+	const __m256 s = _mm256_set1_ps (scale), max = _mm256_set1_ps (32767.0f),
+			min = _mm256_set1_ps (-32768.0f);
+	size_t i = 0;
+
+	if (channels == 2) {
+		const float * const l = src[0], * const r = src[1];
+		for (; i + 8 <= samples; i += 8) {
+			const __m256 vl = _mm256_mul_ps (_mm256_loadu_ps (&l[i]), s),
+					vr = _mm256_mul_ps (_mm256_loadu_ps (&r[i]), s);
+			/* interleaves within 128 bit lanes, packs below restores the
+			 * order */
+			__m256 a = _mm256_add_ps (_mm256_unpacklo_ps (vl, vr),
+					_mm256_loadu_ps (&noise[2*i]));
+			__m256 b = _mm256_add_ps (_mm256_unpackhi_ps (vl, vr),
+					_mm256_loadu_ps (&noise[2*i+8]));
+			a = _mm256_max_ps (_mm256_min_ps (a, max), min);
+			b = _mm256_max_ps (_mm256_min_ps (b, max), min);
+			_mm256_storeu_si256 ((__m256i *) &dst[2*i],
+					_mm256_packs_epi32 (_mm256_cvtps_epi32 (a),
+					_mm256_cvtps_epi32 (b)));
+		}
+	} else if (channels == 1) {
+		const float * const m = src[0];
+		for (; i + 16 <= samples; i += 16) {
+			__m256 a = _mm256_add_ps (_mm256_mul_ps (_mm256_loadu_ps (&m[i]), s),
+					_mm256_loadu_ps (&noise[i]));
+			__m256 b = _mm256_add_ps (_mm256_mul_ps (_mm256_loadu_ps (&m[i+8]), s),
+					_mm256_loadu_ps (&noise[i+8]));
+			a = _mm256_max_ps (_mm256_min_ps (a, max), min);
+			b = _mm256_max_ps (_mm256_min_ps (b, max), min);
+			/* packs works on 128 bit lanes, reorder 64 bit blocks */
+			const __m256i p = _mm256_packs_epi32 (_mm256_cvtps_epi32 (a),
+					_mm256_cvtps_epi32 (b));
+			_mm256_storeu_si256 ((__m256i *) &dst[i],
+					_mm256_permute4x64_epi64 (p, 0xd8));
+		}
+	} else {
+		toS16Scalar (dst, src, channels, samples, scale, noise);
+		return;
+	}
+	convertTail (toS16Scalar, dst, sizeof (*dst), src, channels, samples, scale,
+			noise, i);
+}
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+static inline int32x4_t neonRound (const float32x4_t v) {
+#ifdef __aarch64__
+	return vcvtnq_s32_f32 (v);
+#else
+	/* vcvtq truncates, add 0.5 with the sign of v */
+	const float32x4_t half = vbslq_f32 (vdupq_n_u32 (0x80000000), v,
+			vdupq_n_f32 (0.5f));
+	return vcvtq_s32_f32 (vaddq_f32 (v, half));
+#endif
+}
+
+/* conversion and narrowing saturate, no clamping required */
+static void toS16Neon (void * const out, const float * const * const src,
+		const size_t channels, const size_t samples, const float scale,
+		const float * const noise) {
+	int16_t * const dst = out;
+	size_t i = 0;
+
+	if (channels == 2) {
+		const float * const l = src[0], * const r = src[1];
+		for (; i + 4 <= samples; i += 4) {
+			const float32x4x2_t z = vzipq_f32 (
+					vmulq_n_f32 (vld1q_f32 (&l[i]), scale),
+					vmulq_n_f32 (vld1q_f32 (&r[i]), scale));
+			const float32x4_t a = vaddq_f32 (z.val[0], vld1q_f32 (&noise[2*i])),
+					b = vaddq_f32 (z.val[1], vld1q_f32 (&noise[2*i+4]));
+			vst1q_s16 (&dst[2*i], vcombine_s16 (vqmovn_s32 (neonRound (a)),
+					vqmovn_s32 (neonRound (b))));
+		}
+	} else if (channels == 1) {
+		const float * const m = src[0];
+		for (; i + 8 <= samples; i += 8) {
+			const float32x4_t a = vaddq_f32 (vmulq_n_f32 (vld1q_f32 (&m[i]),
+					scale), vld1q_f32 (&noise[i])),
+					b = vaddq_f32 (vmulq_n_f32 (vld1q_f32 (&m[i+4]), scale),
+					vld1q_f32 (&noise[i+4]));
+			vst1q_s16 (&dst[i], vcombine_s16 (vqmovn_s32 (neonRound (a)),
+					vqmovn_s32 (neonRound (b))));
+		}
+	} else {
+		toS16Scalar (dst, src, channels, samples, scale, noise);
+		return;
+	}
+	convertTail (toS16Scalar, dst, sizeof (*dst), src, channels, samples, scale,
+			noise, i);
+}
+
+/* the conversion saturates, stores interleave */
+static void toS32Neon (void * const out, const float * const * const src,
+		const size_t channels, const size_t samples, const float scale,
+		const float * const noise) {
+	int32_t * const dst = out;
+	size_t i = 0;
+
+	if (channels == 2) {
+		const float * const l = src[0], * const r = src[1];
+		for (; i + 4 <= samples; i += 4) {
+			const int32x4x2_t v = {{
+					neonRound (vmulq_n_f32 (vld1q_f32 (&l[i]), scale)),
+					neonRound (vmulq_n_f32 (vld1q_f32 (&r[i]), scale))}};
+			vst2q_s32 (&dst[2*i], v);
+		}
+	} else if (channels == 1) {
+		const float * const m = src[0];
+		for (; i + 4 <= samples; i += 4) {
+			vst1q_s32 (&dst[i], neonRound (vmulq_n_f32 (vld1q_f32 (&m[i]),
+					scale)));
+		}
+	} else {
+		toS32Scalar (dst, src, channels, samples, scale, noise);
+		return;
+	}
+	convertTail (toS32Scalar, dst, sizeof (*dst), src, channels, samples, scale,
+			noise, i);
+}
+
+static void toF32Neon (void * const out, const float * const * const src,
+		const size_t channels, const size_t samples, const float scale,
+		const float * const noise) {
+	float * const dst = out;
+	size_t i = 0;
+
+	if (channels == 2) {
+		const float * const l = src[0], * const r = src[1];
+		for (; i + 4 <= samples; i += 4) {
+			const float32x4x2_t v = {{vmulq_n_f32 (vld1q_f32 (&l[i]), scale),
+					vmulq_n_f32 (vld1q_f32 (&r[i]), scale)}};
+			vst2q_f32 (&dst[2*i], v);
+		}
+	} else if (channels == 1) {
+		const float * const m = src[0];
+		for (; i + 4 <= samples; i += 4) {
+			vst1q_f32 (&dst[i], vmulq_n_f32 (vld1q_f32 (&m[i]), scale));
+		}
+	} else {
+		toF32Scalar (dst, src, channels, samples, scale, noise);
+		return;
+	}
+	convertTail (toF32Scalar, dst, sizeof (*dst), src, channels, samples, scale,
+			noise, i);
+}
+#endif
+
+/*	dst = a*ga + b*gb, with ga and gb changing linearly from ga0/gb0 to
+ *	ga1/gb1 over n samples. dst may be a.
+ */
+void BarMixFade (float * const dst, const float * const a,
+		const float * const b, const size_t n, const float ga0,
+		const float ga1, const float gb0, const float gb1) {
+	const float da = n > 0 ? (ga1 - ga0) / n : 0,
+			db = n > 0 ? (gb1 - gb0) / n : 0;
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	__m128 ga = _mm_add_ps (_mm_set1_ps (ga0),
+			_mm_mul_ps (_mm_set1_ps (da), _mm_set_ps (3, 2, 1, 0))),
+			gb = _mm_add_ps (_mm_set1_ps (gb0),
+			_mm_mul_ps (_mm_set1_ps (db), _mm_set_ps (3, 2, 1, 0)));
+	const __m128 stepa = _mm_set1_ps (4*da), stepb = _mm_set1_ps (4*db);
+	for (; i + 4 <= n; i += 4) {
+		_mm_storeu_ps (&dst[i], _mm_add_ps (
+				_mm_mul_ps (_mm_loadu_ps (&a[i]), ga),
+				_mm_mul_ps (_mm_loadu_ps (&b[i]), gb)));
+		ga = _mm_add_ps (ga, stepa);
+		gb = _mm_add_ps (gb, stepb);
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	static const float ramp[4] = {0, 1, 2, 3};
+	const float32x4_t r = vld1q_f32 (ramp);
+	float32x4_t ga = vmlaq_n_f32 (vdupq_n_f32 (ga0), r, da),
+			gb = vmlaq_n_f32 (vdupq_n_f32 (gb0), r, db);
+	const float32x4_t stepa = vdupq_n_f32 (4*da), stepb = vdupq_n_f32 (4*db);
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32 (&dst[i], vmlaq_f32 (vmulq_f32 (vld1q_f32 (&a[i]), ga),
+				vld1q_f32 (&b[i]), gb));
+		ga = vaddq_f32 (ga, stepa);
+		gb = vaddq_f32 (gb, stepb);
+	}
+#endif
+	for (; i < n; i++) {
+		dst[i] = a[i] * (ga0 + da*i) + b[i] * (gb0 + db*i);
+	}
+}
+
+/*	Fill the noise table and pick the kernel
+ */
+void BarMixInit (BarMix_t * const mix) {
+	assert (mix != NULL);
+
+	uint32_t x = 0x9e3779b9;
+	for (size_t i = 0; i < BAR_MIX_NOISE; i++) {
+		/* difference of two uniform values in [0,1) is triangular */
+		x = xorshift (x);
+		const float a = (float) (x >> 8) / (float) (1 << 24);
+		x = xorshift (x);
+		const float b = (float) (x >> 8) / (float) (1 << 24);
+		mix->noise[i] = mix->noise[BAR_MIX_NOISE+i] = a - b;
+	}
+	mix->seed = x;
+
+	mix->kernel[BAR_MIX_S16] = toS16Scalar;
+	mix->kernel[BAR_MIX_S32] = toS32Scalar;
+	mix->kernel[BAR_MIX_F32] = toF32Scalar;
+#if defined(__SSE2__)
+	mix->kernel[BAR_MIX_S16] = toS16Sse2;
+	mix->kernel[BAR_MIX_S32] = toS32Sse2;
+	mix->kernel[BAR_MIX_F32] = toF32Sse2;
+#endif
+#ifdef HAVE_MIX_AVX2
+	/* the others are limited by memory bandwidth */
+	if (__builtin_cpu_supports ("avx2")) {
+		mix->kernel[BAR_MIX_S16] = toS16Avx2;
+	}
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	mix->kernel[BAR_MIX_S16] = toS16Neon;
+	mix->kernel[BAR_MIX_S32] = toS32Neon;
+	mix->kernel[BAR_MIX_F32] = toF32Neon;
+#endif
+}
+
+/*	Size of a single value
+ */
+size_t BarMixSampleSize (const BarMixFormat_t format) {
+	switch (format) {
+		case BAR_MIX_S16:
+			return sizeof (int16_t);
+
+		case BAR_MIX_S32:
+			return sizeof (int32_t);
+
+		case BAR_MIX_F32:
+			return sizeof (float);
+
+		default:
+			assert (0);
+			return 0;
+	}
+}
+
+/*	Convert planar float samples to interleaved values of the device format
+ *	@param destination, samples*channels values
+ *	@param destination format
+ *	@param one plane per channel
+ *	@param channels, at most BAR_MIX_MAXCHANNELS
+ *	@param samples per channel
+ *	@param linear gain
+ *	@param add triangular dither, S16 only
+ */
+void BarMixConvert (BarMix_t * const mix, void * const dst,
+		const BarMixFormat_t format, const float * const * const src,
+		const size_t channels, const size_t samples, const float gain,
+		bool dither) {
+	assert (mix != NULL);
+	assert (channels > 0 && channels <= BAR_MIX_MAXCHANNELS);
+
+	float scale = gain;
+	switch (format) {
+		case BAR_MIX_S16:
+			scale *= 32768.0f;
+			break;
+
+		case BAR_MIX_S32:
+			/* the quantization error is far below any DAC's noise floor */
+			scale *= 2147483648.0f;
+			dither = false;
+			break;
+
+		case BAR_MIX_F32:
+			dither = false;
+			break;
+
+		default:
+			assert (0);
+			break;
+	}
+	const size_t size = BarMixSampleSize (format);
+	/* noise must not wrap within one kernel call */
+	const size_t span = BAR_MIX_NOISE / channels;
+	for (size_t i = 0; i < samples; i += span) {
+		const size_t n = samples - i < span ? samples - i : span;
+		const float *noise = silence;
+		if (dither) {
+			mix->seed = xorshift (mix->seed);
+			noise = &mix->noise[mix->seed % BAR_MIX_NOISE];
+		}
+		const float *planes[BAR_MIX_MAXCHANNELS];
+		for (size_t c = 0; c < channels; c++) {
+			planes[c] = src[c] + i;
+		}
+		mix->kernel[format] ((uint8_t *) dst + i*channels*size, planes,
+				channels, n, scale, noise);
+	}
+}
+
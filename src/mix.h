@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* dither noise table length in samples */
+#define BAR_MIX_NOISE 4096
+/* planes supported by BarMixConvert */
+#define BAR_MIX_MAXCHANNELS 8
+
+/* interleaved output formats, native endianness */
+typedef enum {
+	BAR_MIX_S16 = 0,
+	BAR_MIX_S32,
+	BAR_MIX_F32,
+	BAR_MIX_FORMATS,
+} BarMixFormat_t;
+
+typedef void (*BarMixKernel_t) (void * const, const float * const * const,
+		const size_t, const size_t, const float, const float * const);
+
+/* sample conversion state, see BarMixInit */
+typedef struct {
+	/* triangular noise of one LSB, stored twice so it can be read linearly
+	 * from any offset < BAR_MIX_NOISE */
+	float noise[2*BAR_MIX_NOISE];
+	uint32_t seed;
+	/* best kernel for this cpu, per format */
+	BarMixKernel_t kernel[BAR_MIX_FORMATS];
+} BarMix_t;
+
+void BarMixInit (BarMix_t * const);
+size_t BarMixSampleSize (const BarMixFormat_t);
+void BarMixConvert (BarMix_t * const, void * const, const BarMixFormat_t,
+		const float * const * const, const size_t, const size_t, const float,
+		bool);
+void BarMixFade (float * const, const float * const, const float * const,
+		const size_t, const float, const float, const float, const float);
+
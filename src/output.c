@@ -0,0 +1,766 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* audio output backends.
+ *
+ * The decoder opens the device for every track, which reuses the previous
+ * track’s device if the format did not change. The output worker writes
+ * to it, possibly with real-time priority, so writing must not lock or
+ * allocate. Blocking writes return early once wakeFd is readable, except
+ * for libao, which cannot be interrupted.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+
+#include "output.h"
+#include "debug.h"
+#include "ui.h"
+
+static double bytesPerSec (const BarOutput_t * const o) {
+	return (double) o->rate * o->channels * BarMixSampleSize (o->format);
+}
+
+/*	Consume pending wake-ups
+ */
+static void clearWake (const int fd) {
+	char buf[16];
+	while (read (fd, buf, sizeof (buf)) > 0);
+}
+
+/*	libao’s default driver. libao has no float samples, but 32 bit integers
+ *	keep everything the decoder produces.
+ */
+static bool aoOpen (BarOutput_t * const o, const bool negotiate) {
+	// use driver from libao configuration
+	const int driver = ao_default_driver_id ();
+	ao_option *options = NULL;
+	const unsigned int period = o->settings->audioPeriod;
+	const ao_info * const info = ao_driver_info (driver);
+	/* libao does not report its buffer size, libao’s ALSA driver defaults
+	 * to 100 ms */
+	o->aoBuffer = 0.1;
+	if (period > 0 && info != NULL) {
+		/* make room for two periods, so the device does not run dry
+		 * while we are asleep */
+		char buf[32];
+		if (strcmp (info->short_name, "alsa") == 0) {
+			/* microseconds */
+			snprintf (buf, sizeof (buf), "%u", period*1000);
+			ao_append_option (&options, "period_time", buf);
+		}
+		if (strcmp (info->short_name, "alsa") == 0 ||
+				strcmp (info->short_name, "pulse") == 0) {
+			/* milliseconds */
+			snprintf (buf, sizeof (buf), "%u", period*2);
+			ao_append_option (&options, "buffer_time", buf);
+			o->aoBuffer = period*2 / 1000.0;
+		}
+	}
+	if (o->settings->audioLatency > 0) {
+		o->aoBuffer = o->settings->audioLatency / 1000.0;
+	}
+
+	ao_sample_format aoFmt;
+	memset (&aoFmt, 0, sizeof (aoFmt));
+	aoFmt.channels = o->channels;
+	aoFmt.rate = o->rate;
+	aoFmt.byte_format = AO_FMT_NATIVE;
+
+	/* formats to try, best first */
+	BarMixFormat_t formats[] = {BAR_MIX_S32, BAR_MIX_S16};
+	size_t numFormats = sizeof (formats) / sizeof (*formats);
+	if (!negotiate) {
+		/* the output worker converts to this already */
+		formats[0] = o->format;
+		numFormats = 1;
+	}
+	for (size_t i = 0; i < numFormats && o->aoDev == NULL; i++) {
+		aoFmt.bits = BarMixSampleSize (formats[i]) * 8;
+		o->aoDev = ao_open_live (driver, &aoFmt, options);
+		if (o->aoDev != NULL) {
+			o->format = formats[i];
+		}
+	}
+	ao_free_options (options);
+	if (o->aoDev == NULL) {
+		return false;
+	}
+	debugPrint (DEBUG_AUDIO, "opened device with %i bit samples\n",
+			aoFmt.bits);
+	o->aoQueued = 0;
+
+	return true;
+}
+
+/*	Seconds in libao’s buffer: It drains in real time and is full once
+ *	ao_play blocks.
+ */
+static double aoFill (const BarOutput_t * const o,
+		const struct timespec * const now) {
+	const double queued = o->aoQueued -
+			(double) (now->tv_sec - o->aoQueuedAt.tv_sec) -
+			(double) (now->tv_nsec - o->aoQueuedAt.tv_nsec) / 1e9;
+	return queued > 0 ? queued : 0;
+}
+
+static ssize_t aoWrite (BarOutput_t * const o, const uint8_t * const buf,
+		const size_t len) {
+	if (ao_play (o->aoDev, (char *) buf, len) == 0) {
+		return -1;
+	}
+
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	const double queued = aoFill (o, &now) + len / bytesPerSec (o);
+	o->aoQueued = queued < o->aoBuffer ? queued : o->aoBuffer;
+	o->aoQueuedAt = now;
+
+	return len;
+}
+
+static double aoLatency (BarOutput_t * const o) {
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return aoFill (o, &now);
+}
+
+static void aoClose (BarOutput_t * const o) {
+	/* drains */
+	ao_close (o->aoDev);
+	o->aoDev = NULL;
+}
+
+/*	audio_pipe, written directly instead of using libao’s raw driver, which
+ *	blocks the output worker while the reader is slow and copies everything
+ *	once more
+ */
+static bool pipeOpen (BarOutput_t * const o, const bool negotiate) {
+	const BarSettings_t * const settings = o->settings;
+	const char * const path = settings->audioPipe;
+
+	struct stat st;
+	if (stat (path, &st)) {
+		BarUiMsg (settings, MSG_ERR, "Cannot stat audio pipe file.\n");
+		return false;
+	}
+	if (!S_ISFIFO (st.st_mode)) {
+		BarUiMsg (settings, MSG_ERR, "File is not a pipe, error.\n");
+		return false;
+	}
+
+	/* blocks until there is a reader */
+	const int fd = open (path, O_WRONLY | O_CLOEXEC);
+	if (fd == -1) {
+		BarUiMsg (settings, MSG_ERR, "Cannot open audio pipe file.\n");
+		return false;
+	}
+	/* waiting for the reader is done by pipeWrite */
+	fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+
+	o->format = settings->audioPipeFormat;
+#ifdef F_SETPIPE_SZ
+	/* a second of audio smoothes over a reader that works in bursts (like
+	 * encoders do). The kernel limits the size for unprivileged users, so
+	 * try smaller sizes as well, down to the default of 64 KiB. */
+	int size = bytesPerSec (o);
+	while (size > 65536 && fcntl (fd, F_SETPIPE_SZ, size) == -1) {
+		size /= 2;
+	}
+	debugPrint (DEBUG_AUDIO, "audio pipe holds %i bytes\n",
+			fcntl (fd, F_GETPIPE_SZ));
+#endif
+	o->fd = fd;
+
+	return true;
+}
+
+/*	Waiting for a slow reader can be interrupted, EPIPE if the reader went
+ *	away
+ */
+static ssize_t pipeWrite (BarOutput_t * const o, const uint8_t * const buf,
+		const size_t len) {
+	size_t done = 0;
+
+	while (done < len) {
+		const ssize_t ret = write (o->fd, buf + done, len - done);
+		if (ret >= 0) {
+			done += ret;
+		} else if (errno == EAGAIN) {
+			struct pollfd pfd[2] = {
+					{.fd = o->fd, .events = POLLOUT},
+					{.fd = o->wakeFd, .events = POLLIN},
+					};
+			poll (pfd, 2, -1);
+			if (pfd[1].revents & POLLIN) {
+				clearWake (o->wakeFd);
+				break;
+			}
+		} else if (errno != EINTR) {
+			return -1;
+		}
+	}
+
+	return done;
+}
+
+/*	Bytes the reader did not consume yet
+ */
+static double pipeLatency (BarOutput_t * const o) {
+	int queued;
+	if (ioctl (o->fd, FIONREAD, &queued) != 0) {
+		return -1;
+	}
+	return queued / bytesPerSec (o);
+}
+
+static void fdClose (BarOutput_t * const o) {
+	close (o->fd);
+	o->fd = -1;
+}
+
+static void putLe (uint8_t * const dst, const uint32_t v, const size_t bytes) {
+	for (size_t i = 0; i < bytes; i++) {
+		dst[i] = (v >> (8*i)) & 0xff;
+	}
+}
+
+/*	WAV header for o->wavBytes of data
+ */
+static void wavHeader (const BarOutput_t * const o, uint8_t * const wav) {
+	const unsigned int sampleSize = BarMixSampleSize (o->format);
+	const unsigned int blockAlign = o->channels * sampleSize;
+	const uint32_t dataSize = o->wavBytes > UINT32_MAX - 36 ?
+			UINT32_MAX - 36 : o->wavBytes;
+
+	memcpy (&wav[0], "RIFF", 4);
+	putLe (&wav[4], dataSize + 36, 4);
+	memcpy (&wav[8], "WAVEfmt ", 8);
+	putLe (&wav[16], 16, 4);
+	/* integer PCM or IEEE float */
+	putLe (&wav[20], o->format == BAR_MIX_F32 ? 3 : 1, 2);
+	putLe (&wav[22], o->channels, 2);
+	putLe (&wav[24], o->rate, 4);
+	putLe (&wav[28], o->rate * blockAlign, 4);
+	putLe (&wav[32], blockAlign, 2);
+	putLe (&wav[34], sampleSize * 8, 2);
+	memcpy (&wav[36], "data", 4);
+	putLe (&wav[40], dataSize, 4);
+}
+
+/*	WAV file audio_device in audio_pipe_format, written as fast as possible.
+ *	Samples are in native byte order, WAV expects little endian.
+ */
+static bool wavOpen (BarOutput_t * const o, const bool negotiate) {
+	const BarSettings_t * const settings = o->settings;
+
+	if (settings->audioDevice == NULL) {
+		BarUiMsg (settings, MSG_ERR, "audio_device must be set to a file for "
+				"wav output.\n");
+		return false;
+	}
+	const int fd = open (settings->audioDevice,
+			O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		BarUiMsg (settings, MSG_ERR, "Cannot open wav file (%s).\n",
+				strerror (errno));
+		return false;
+	}
+
+	o->format = settings->audioPipeFormat;
+	o->wavBytes = 0;
+	uint8_t header[44];
+	wavHeader (o, header);
+	if (write (fd, header, sizeof (header)) != sizeof (header)) {
+		close (fd);
+		return false;
+	}
+	o->fd = fd;
+
+	return true;
+}
+
+static ssize_t wavWrite (BarOutput_t * const o, const uint8_t * const buf,
+		const size_t len) {
+	size_t done = 0;
+
+	while (done < len) {
+		const ssize_t ret = write (o->fd, buf + done, len - done);
+		if (ret >= 0) {
+			done += ret;
+		} else if (errno != EINTR) {
+			return -1;
+		}
+	}
+	o->wavBytes += done;
+
+	return done;
+}
+
+static double noLatency (BarOutput_t * const o) {
+	return 0;
+}
+
+/*	Fix up the sizes in the header
+ */
+static void wavClose (BarOutput_t * const o) {
+	uint8_t header[44];
+	wavHeader (o, header);
+	if (pwrite (o->fd, header, sizeof (header), 0) != sizeof (header)) {
+		debugPrint (DEBUG_AUDIO, "cannot update wav header\n");
+	}
+	fdClose (o);
+}
+
+/*	Discards everything immediately, for benchmarking the decoder
+ */
+static bool nullOpen (BarOutput_t * const o, const bool negotiate) {
+	if (negotiate) {
+		o->format = BAR_MIX_S16;
+	}
+	return true;
+}
+
+static ssize_t nullWrite (BarOutput_t * const o, const uint8_t * const buf,
+		const size_t len) {
+	return len;
+}
+
+static void nullClose (BarOutput_t * const o) {
+}
+
+#ifdef HAVE_ALSA
+static snd_pcm_format_t alsaFormat (const BarMixFormat_t format) {
+	switch (format) {
+		case BAR_MIX_S32:
+			return SND_PCM_FORMAT_S32;
+
+		case BAR_MIX_F32:
+			return SND_PCM_FORMAT_FLOAT;
+
+		default:
+			return SND_PCM_FORMAT_S16;
+	}
+}
+
+/*	ALSA pcm audio_device, written through mmap. The buffer holds two
+ *	periods of audio_period, or 100 ms.
+ */
+static bool alsaOpen (BarOutput_t * const o, const bool negotiate) {
+	const BarSettings_t * const settings = o->settings;
+	const char * const device = settings->audioDevice != NULL ?
+			settings->audioDevice : "default";
+	int ret;
+
+	if ((ret = snd_pcm_open (&o->pcm, device, SND_PCM_STREAM_PLAYBACK,
+			0)) < 0) {
+		debugPrint (DEBUG_AUDIO, "cannot open pcm %s: %s\n", device,
+				snd_strerror (ret));
+		o->pcm = NULL;
+		return false;
+	}
+
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_hw_params_alloca (&hw);
+	snd_pcm_hw_params_any (o->pcm, hw);
+	if ((ret = snd_pcm_hw_params_set_access (o->pcm, hw,
+			SND_PCM_ACCESS_MMAP_INTERLEAVED)) < 0) {
+		goto fail;
+	}
+
+	/* formats to try, best first. Float leaves the conversion to the device
+	 * or alsa-lib. */
+	BarMixFormat_t formats[] = {BAR_MIX_F32, BAR_MIX_S32, BAR_MIX_S16};
+	size_t numFormats = sizeof (formats) / sizeof (*formats);
+	if (!negotiate) {
+		formats[0] = o->format;
+		numFormats = 1;
+	}
+	ret = -EINVAL;
+	for (size_t i = 0; i < numFormats && ret < 0; i++) {
+		if ((ret = snd_pcm_hw_params_set_format (o->pcm, hw,
+				alsaFormat (formats[i]))) == 0) {
+			o->format = formats[i];
+		}
+	}
+	if (ret < 0) {
+		goto fail;
+	}
+
+	const unsigned int period = settings->audioPeriod > 0 ?
+			settings->audioPeriod * 1000 : 25000;
+	unsigned int periodTime = period, bufferTime = settings->audioPeriod > 0 ?
+			period * 2 : 100000;
+	if ((ret = snd_pcm_hw_params_set_channels (o->pcm, hw, o->channels)) < 0 ||
+			(ret = snd_pcm_hw_params_set_rate (o->pcm, hw, o->rate, 0)) < 0 ||
+			(ret = snd_pcm_hw_params_set_buffer_time_near (o->pcm, hw,
+					&bufferTime, NULL)) < 0 ||
+			(ret = snd_pcm_hw_params_set_period_time_near (o->pcm, hw,
+					&periodTime, NULL)) < 0 ||
+			(ret = snd_pcm_hw_params (o->pcm, hw)) < 0) {
+		goto fail;
+	}
+	snd_pcm_hw_params_get_period_size (hw, &o->period, NULL);
+
+	/* started by alsaWrite */
+	snd_pcm_sw_params_t *sw;
+	snd_pcm_sw_params_alloca (&sw);
+	snd_pcm_sw_params_current (o->pcm, sw);
+	if ((ret = snd_pcm_sw_params_set_avail_min (o->pcm, sw, o->period)) < 0 ||
+			(ret = snd_pcm_sw_params (o->pcm, sw)) < 0) {
+		goto fail;
+	}
+
+	/* the pcm’s descriptors and wakeFd */
+	o->pfdCount = snd_pcm_poll_descriptors_count (o->pcm);
+	if (o->pfdCount < 0 ||
+			(o->pfd = calloc (o->pfdCount + 1, sizeof (*o->pfd))) == NULL) {
+		ret = -ENOMEM;
+		goto fail;
+	}
+	snd_pcm_poll_descriptors (o->pcm, o->pfd, o->pfdCount);
+	o->pfd[o->pfdCount].fd = o->wakeFd;
+	o->pfd[o->pfdCount].events = POLLIN;
+
+	debugPrint (DEBUG_AUDIO, "opened pcm %s, buffer %u us, period %u us\n",
+			device, bufferTime, periodTime);
+	return true;
+
+fail:
+	debugPrint (DEBUG_AUDIO, "cannot configure pcm %s: %s\n", device,
+			snd_strerror (ret));
+	snd_pcm_close (o->pcm);
+	o->pcm = NULL;
+	return false;
+}
+
+/*	Wait for room in the buffer
+ *	@return false if interrupted
+ */
+static bool alsaWait (BarOutput_t * const o) {
+	for (int i = 0; i <= o->pfdCount; i++) {
+		o->pfd[i].revents = 0;
+	}
+	poll (o->pfd, o->pfdCount + 1, 1000);
+	if (o->pfd[o->pfdCount].revents & POLLIN) {
+		clearWake (o->wakeFd);
+		return false;
+	}
+	/* errors are reported by snd_pcm_avail_update */
+	unsigned short revents;
+	snd_pcm_poll_descriptors_revents (o->pcm, o->pfd, o->pfdCount, &revents);
+	return true;
+}
+
+static ssize_t alsaWrite (BarOutput_t * const o, const uint8_t * const buf,
+		const size_t len) {
+	const size_t frameBytes = o->channels * BarMixSampleSize (o->format);
+	size_t done = 0;
+
+	while (done < len) {
+		const snd_pcm_uframes_t want = (len - done) / frameBytes;
+		const snd_pcm_sframes_t avail = snd_pcm_avail_update (o->pcm);
+		if (avail < 0) {
+			/* underrun, or suspended */
+			if (snd_pcm_recover (o->pcm, avail, 1) < 0) {
+				return -1;
+			}
+			continue;
+		} else if ((snd_pcm_uframes_t) avail < want &&
+				(snd_pcm_uframes_t) avail < o->period) {
+			if (!alsaWait (o)) {
+				break;
+			}
+			continue;
+		}
+
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t offset, frames = want;
+		int ret;
+		if ((ret = snd_pcm_mmap_begin (o->pcm, &areas, &offset, &frames)) < 0) {
+			if (snd_pcm_recover (o->pcm, ret, 1) < 0) {
+				return -1;
+			}
+			continue;
+		}
+		/* interleaved, the first area covers all channels */
+		memcpy ((uint8_t *) areas[0].addr +
+				(areas[0].first + offset * areas[0].step) / 8, buf + done,
+				frames * frameBytes);
+		const snd_pcm_sframes_t committed = snd_pcm_mmap_commit (o->pcm,
+				offset, frames);
+		if (committed < 0) {
+			if (snd_pcm_recover (o->pcm, committed, 1) < 0) {
+				return -1;
+			}
+			continue;
+		}
+		done += committed * frameBytes;
+
+		/* mmap transfers do not start the pcm */
+		if (snd_pcm_state (o->pcm) == SND_PCM_STATE_PREPARED &&
+				(ret = snd_pcm_start (o->pcm)) < 0 &&
+				snd_pcm_recover (o->pcm, ret, 1) < 0) {
+			return -1;
+		}
+	}
+
+	return done;
+}
+
+static void alsaDrain (BarOutput_t * const o) {
+	snd_pcm_drain (o->pcm);
+}
+
+static bool alsaPause (BarOutput_t * const o, const bool pause) {
+	return snd_pcm_pause (o->pcm, pause) == 0;
+}
+
+static double alsaLatency (BarOutput_t * const o) {
+	snd_pcm_sframes_t delay;
+	if (snd_pcm_delay (o->pcm, &delay) < 0) {
+		return -1;
+	}
+	return delay > 0 ? (double) delay / o->rate : 0;
+}
+
+static void alsaClose (BarOutput_t * const o) {
+	snd_pcm_close (o->pcm);
+	o->pcm = NULL;
+	free (o->pfd);
+	o->pfd = NULL;
+}
+#endif
+
+static const BarOutputDriver_t aoDriver = {"ao", true, aoOpen, aoWrite, NULL,
+		NULL, aoLatency, aoClose};
+static const BarOutputDriver_t pipeDriver = {"pipe", false, pipeOpen,
+		pipeWrite, NULL, NULL, pipeLatency, fdClose};
+static const BarOutputDriver_t wavDriver = {"wav", false, wavOpen, wavWrite,
+		NULL, NULL, noLatency, wavClose};
+static const BarOutputDriver_t nullDriver = {"null", false, nullOpen,
+		nullWrite, NULL, NULL, noLatency, nullClose};
+#ifdef HAVE_ALSA
+static const BarOutputDriver_t alsaDriver = {"alsa", true, alsaOpen,
+		alsaWrite, alsaDrain, alsaPause, alsaLatency, alsaClose};
+#endif
+
+static const BarOutputDriver_t * const drivers[] = {&aoDriver, &wavDriver,
+		&nullDriver,
+#ifdef HAVE_ALSA
+		&alsaDriver,
+#endif
+		};
+
+/*	Driver selected by audio_output, audio_pipe takes precedence
+ */
+static const BarOutputDriver_t *findDriver (const BarSettings_t * const settings) {
+	if (settings->audioPipe != NULL) {
+		return &pipeDriver;
+	}
+	for (size_t i = 0; i < sizeof (drivers) / sizeof (*drivers); i++) {
+		if (strcmp (drivers[i]->name, settings->audioOutput) == 0) {
+			return drivers[i];
+		}
+	}
+	BarUiMsg (settings, MSG_ERR, "Audio output %s is not available.\n",
+			settings->audioOutput);
+	return NULL;
+}
+
+void BarOutputInit (BarOutput_t * const o, const BarSettings_t * const settings,
+		const int wakeFd) {
+	assert (o != NULL);
+
+	memset (o, 0, sizeof (*o));
+	o->settings = settings;
+	o->wakeFd = wakeFd;
+	o->fd = -1;
+	o->format = BAR_MIX_S16;
+	pthread_mutex_init (&o->lock, NULL);
+	ao_initialize ();
+}
+
+/*	Close the device, lock held
+ */
+static void closeLocked (BarOutput_t * const o, const bool drain) {
+	if (o->open && !o->released) {
+		if (drain && o->driver->drain != NULL) {
+			o->driver->drain (o);
+		}
+		o->driver->close (o);
+	}
+	o->open = false;
+	o->released = false;
+	__atomic_store_n (&o->broken, false, __ATOMIC_RELEASE);
+}
+
+void BarOutputDestroy (BarOutput_t * const o) {
+	pthread_mutex_lock (&o->lock);
+	closeLocked (o, false);
+	pthread_mutex_unlock (&o->lock);
+	pthread_mutex_destroy (&o->lock);
+	ao_shutdown ();
+}
+
+/*	Open the device for rate and channels. The previous one is kept if the
+ *	format did not change, and reopened if it was released.
+ */
+bool BarOutputOpen (BarOutput_t * const o, const unsigned int rate,
+		const unsigned int channels) {
+	const BarSettings_t * const settings = o->settings;
+
+	pthread_mutex_lock (&o->lock);
+	bool ret = true;
+	const bool broken = __atomic_load_n (&o->broken, __ATOMIC_ACQUIRE);
+	if (o->open && !broken && o->rate == rate && o->channels == channels) {
+		/* the sample format was negotiated already */
+		if (o->released) {
+			o->released = !(ret = o->driver->open (o, false));
+		}
+	} else {
+		if (broken && o->driver == &pipeDriver) {
+			BarUiMsg (settings, MSG_INFO, "Audio pipe reader went away, "
+					"waiting for a new one.\n");
+		}
+		closeLocked (o, true);
+		if ((o->driver = findDriver (settings)) != NULL) {
+			o->rate = rate;
+			o->channels = channels;
+			o->open = ret = o->driver->open (o, true);
+		} else {
+			ret = false;
+		}
+	}
+	if (!ret && o->driver != NULL && o->driver->device) {
+		BarUiMsg (settings, MSG_ERR, "Cannot open audio device.\n");
+	}
+	pthread_mutex_unlock (&o->lock);
+
+	return ret;
+}
+
+/*	BarOutputOpen would keep the device, so the previous track can still
+ *	play
+ */
+bool BarOutputCanReuse (BarOutput_t * const o, const unsigned int rate,
+		const unsigned int channels) {
+	pthread_mutex_lock (&o->lock);
+	const bool ret = o->open && !__atomic_load_n (&o->broken, __ATOMIC_ACQUIRE) &&
+			o->rate == rate && o->channels == channels;
+	pthread_mutex_unlock (&o->lock);
+	return ret;
+}
+
+bool BarOutputIsOpen (BarOutput_t * const o) {
+	pthread_mutex_lock (&o->lock);
+	const bool ret = o->open;
+	pthread_mutex_unlock (&o->lock);
+	return ret;
+}
+
+/*	Close after playing everything written
+ */
+void BarOutputClose (BarOutput_t * const o) {
+	pthread_mutex_lock (&o->lock);
+	closeLocked (o, true);
+	pthread_mutex_unlock (&o->lock);
+}
+
+/*	Write interleaved samples in o->format, output worker only. Does not
+ *	lock.
+ *	@return bytes written, less if interrupted, -1 if the device is gone
+ */
+ssize_t BarOutputWrite (BarOutput_t * const o, const uint8_t * const buf,
+		const size_t len) {
+	if (!o->open || o->released ||
+			__atomic_load_n (&o->broken, __ATOMIC_ACQUIRE)) {
+		return -1;
+	}
+	const ssize_t ret = o->driver->write (o, buf, len);
+	if (ret < 0) {
+		__atomic_store_n (&o->broken, true, __ATOMIC_RELEASE);
+	}
+	return ret;
+}
+
+/*	Seconds until the last sample written is heard, 0 if unknown. Output
+ *	worker only.
+ */
+double BarOutputLatency (BarOutput_t * const o) {
+	if (!o->open || o->released ||
+			__atomic_load_n (&o->broken, __ATOMIC_ACQUIRE)) {
+		return 0;
+	}
+	const double latency = o->driver->latency (o);
+	return latency > 0 ? latency : 0;
+}
+
+/*	Pause or resume the device, output worker only
+ *	@return true if the device supports pausing and was (un)paused
+ */
+bool BarOutputPause (BarOutput_t * const o, const bool pause) {
+	pthread_mutex_lock (&o->lock);
+	const bool ret = o->open && !o->released && o->driver->pause != NULL &&
+			o->driver->pause (o, pause);
+	pthread_mutex_unlock (&o->lock);
+	return ret;
+}
+
+/*	Close the device while paused, so other applications can use it. Files
+ *	and pipes are kept.
+ */
+void BarOutputRelease (BarOutput_t * const o) {
+	pthread_mutex_lock (&o->lock);
+	if (o->open && !o->released && o->driver->device) {
+		debugPrint (DEBUG_AUDIO, "releasing audio device\n");
+		if (o->driver->drain != NULL) {
+			o->driver->drain (o);
+		}
+		o->driver->close (o);
+		o->released = true;
+	}
+	pthread_mutex_unlock (&o->lock);
+}
+
+/*	Reopen a released device with the same format
+ *	@return false if it is still released
+ */
+bool BarOutputReacquire (BarOutput_t * const o) {
+	pthread_mutex_lock (&o->lock);
+	if (o->released) {
+		o->released = !o->driver->open (o, false);
+	}
+	const bool ret = !o->released;
+	pthread_mutex_unlock (&o->lock);
+	return ret;
+}
@@ -0,0 +1,119 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <ao/ao.h>
+#ifdef HAVE_ALSA
+#include <poll.h>
+#include <alsa/asoundlib.h>
+#endif
+
+#include "settings.h"
+#include "mix.h"
+
+struct BarOutput;
+
+/* an audio output backend, see audio_output */
+typedef struct {
+	const char *name;
+	/* plays in real time and may be shared with other applications, see
+	 * audio_pause_release */
+	bool device;
+	/* open for o->rate and o->channels. The sample format is negotiated
+	 * and stored in o->format, unless negotiate is false. */
+	bool (*open) (struct BarOutput * const, const bool negotiate);
+	/* write interleaved samples, may block until the device has room
+	 * @return bytes written, less if o->wakeFd became readable, -1 if the
+	 *         device failed */
+	ssize_t (*write) (struct BarOutput * const, const uint8_t * const,
+			const size_t);
+	/* block until everything written was played, may be NULL */
+	void (*drain) (struct BarOutput * const);
+	/* stop playback and keep buffered samples, may be NULL
+	 * @return true if the device is paused */
+	bool (*pause) (struct BarOutput * const, const bool);
+	/* seconds until the last sample written is heard, < 0 if unknown */
+	double (*latency) (struct BarOutput * const);
+	void (*close) (struct BarOutput * const);
+} BarOutputDriver_t;
+
+/* the audio device, opened by the decoder and written by the output worker.
+ * lock serializes opening and closing, writing does not lock. Format
+ * fields only change while the output worker is idle. */
+typedef struct BarOutput {
+	const BarOutputDriver_t *driver;
+	const BarSettings_t *settings;
+	pthread_mutex_t lock;
+	/* interrupts blocking writes */
+	int wakeFd;
+
+	unsigned int rate, channels;
+	BarMixFormat_t format;
+	/* device is ours, released is set if it was closed while paused and
+	 * is reopened with the same format */
+	bool open, released;
+	/* set by write if the device went away (reader of audio_pipe), it is
+	 * reopened with the next track */
+	bool broken;
+
+	/* ao: libao cannot report its buffer size, it is estimated and its
+	 * fill level modelled */
+	ao_device *aoDev;
+	double aoBuffer, aoQueued;
+	struct timespec aoQueuedAt;
+	/* pipe, wav */
+	int fd;
+	/* wav: data bytes written */
+	uint64_t wavBytes;
+#ifdef HAVE_ALSA
+	/* alsa */
+	snd_pcm_t *pcm;
+	struct pollfd *pfd;
+	int pfdCount;
+	snd_pcm_uframes_t period;
+#endif
+} BarOutput_t;
+
+void BarOutputInit (BarOutput_t * const, const BarSettings_t * const,
+		const int);
+void BarOutputDestroy (BarOutput_t * const);
+bool BarOutputOpen (BarOutput_t * const, const unsigned int,
+		const unsigned int);
+bool BarOutputCanReuse (BarOutput_t * const, const unsigned int,
+		const unsigned int);
+bool BarOutputIsOpen (BarOutput_t * const);
+void BarOutputClose (BarOutput_t * const);
+ssize_t BarOutputWrite (BarOutput_t * const, const uint8_t * const,
+		const size_t);
+double BarOutputLatency (BarOutput_t * const);
+bool BarOutputPause (BarOutput_t * const, const bool);
+void BarOutputRelease (BarOutput_t * const);
+bool BarOutputReacquire (BarOutput_t * const);
@@ -23,15 +23,29 @@ THE SOFTWARE.
 
 /* receive/play audio stream.
  *
- * There are two threads involved here:
+ * These threads are involved here:
  * BarPlayerThread
- * 		Sets up the stream and fetches the data into a ffmpeg buffersrc
+ * 		Long-lived decoder worker. Takes jobs submitted by BarPlayerSubmit,
+ * 		sets up the stream and fetches the data into a ffmpeg buffersrc
+ * BarFetchThread
+ * 		Downloads the stream into a ring buffer read by BarPlayerThread, see
+ * 		fetch.c
+ * reapThread
+ * 		Closes the network connection of a finished song in the background.
  * BarAoPlayThread
- * 		Reads data from the filter chain’s sink and hands it over to libao for
- * 		playback.
+ * 		Long-lived output worker. Takes fixed-size blocks of filtered audio
+ * 		from player->rings and writes them to the audio device (output.c).
+ * 		With crossfade the next track’s ring is mixed into the previous
+ * 		one’s tail, while the decoder works on the next track already. It
+ * 		neither allocates nor locks while playing, so it can run with
+ * 		real-time priority (audio_realtime).
  * 
  */
 
+#ifdef __linux__
+/* pthread_setaffinity_np */
+#define _GNU_SOURCE
+#endif
 #include "config.h"
 
 #include <unistd.h>
@@ -42,8 +56,11 @@ THE SOFTWARE.
 #include <limits.h>
 #include <assert.h>
 #include <inttypes.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
 #include <arpa/inet.h>
-#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include <libavcodec/avcodec.h>
 #include <libavutil/avutil.h>
@@ -63,8 +80,10 @@ THE SOFTWARE.
 #include "ui.h"
 #include "ui_types.h"
 
-/* default sample format */
-const enum AVSampleFormat avformat = AV_SAMPLE_FMT_S16;
+/* filter graph output, converted to the device format by BarMixConvert */
+const enum AVSampleFormat avformat = AV_SAMPLE_FMT_FLTP;
+/* samples per ring block, unless audio_period is set */
+static const unsigned int defaultBlockSamples = 1024;
 
 static void printError (const BarSettings_t * const settings,
 		const char * const msg, int ret) {
@@ -73,10 +92,110 @@ static void printError (const BarSettings_t * const settings,
 	BarUiMsg (settings, MSG_ERR, "%s (%s)\n", msg, avmsg);
 }
 
-/*	global initialization
+/* resources of a finished song, released in the background by reapThread,
+ * so skipping does not wait for the network */
+typedef struct {
+	AVFormatContext *fctx;
+	BarFetch_t *fetch;
+} BarPlayerReap_t;
+
+static pthread_mutex_t reapLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reapCond = PTHREAD_COND_INITIALIZER;
+/* reapers running */
+static unsigned int reapPending = 0;
+
+static void *reapThread (void *data) {
+	BarPlayerReap_t * const r = data;
+
+	if (r->fctx != NULL) {
+		avformat_close_input (&r->fctx);
+	}
+	if (r->fetch != NULL) {
+		BarFetchClose (r->fetch);
+		free (r->fetch);
+	}
+	free (r);
+
+	pthread_mutex_lock (&reapLock);
+	--reapPending;
+	pthread_cond_broadcast (&reapCond);
+	pthread_mutex_unlock (&reapLock);
+
+	return NULL;
+}
+
+/*	Wait for all reapers
+ */
+static void reapWait () {
+	pthread_mutex_lock (&reapLock);
+	while (reapPending > 0) {
+		pthread_cond_wait (&reapCond, &reapLock);
+	}
+	pthread_mutex_unlock (&reapLock);
+}
+
+/*	Non-blocking, close-on-exec pipe, both ends -1 on failure
+ */
+static void openPipe (int fd[2]) {
+	if (pipe (fd) == -1) {
+		fd[0] = fd[1] = -1;
+	} else {
+		for (size_t i = 0; i < 2; i++) {
+			fcntl (fd[i], F_SETFL, fcntl (fd[i], F_GETFL) | O_NONBLOCK);
+			fcntl (fd[i], F_SETFD, FD_CLOEXEC);
+		}
+	}
+}
+
+static void closePipe (int fd[2]) {
+	for (size_t i = 0; i < 2; i++) {
+		if (fd[i] != -1) {
+			close (fd[i]);
+		}
+	}
+}
+
+/*	Initial state, per-track state is reset by the workers themselves
+ */
+static void resetPlayer (player_t * const p) {
+	p->doQuit = false;
+	p->doPause = false;
+	p->songDuration = 0;
+	p->songPlayed = 0;
+	p->bufferHealth = 0;
+	p->mode = PLAYER_DEAD;
+	p->fgraph = NULL;
+	p->fctx = NULL;
+	p->st = NULL;
+	p->cctx = NULL;
+	p->fbufsink = NULL;
+	p->fabuf = NULL;
+	p->result = PLAYER_RET_OK;
+	p->streamIdx = -1;
+	p->lastTimestamp = 0;
+	p->resumeAt = 0;
+	p->downgrade = false;
+	p->interrupted = 0;
+	p->underruns = 0;
+	p->underrunsTotal = 0;
+	p->underrunMs = 0;
+	p->underrunPos = 0;
+	p->jitterUs = 0;
+	p->wakeups = 0;
+	p->seekBy = 0;
+	p->urls = NULL;
+	p->quality = PIANO_AQ_UNKNOWN;
+	memset (&p->queue, 0, sizeof (p->queue));
+	memset (&p->played, 0, sizeof (p->played));
+	p->fetch = NULL;
+	p->prefetch = NULL;
+	p->prefetching = false;
+}
+
+/*	global initialization, starts the workers. settings must be read
+ *	already.
  */
 void BarPlayerInit (player_t * const p, const BarSettings_t * const settings) {
-	ao_initialize ();
 	av_log_set_level (AV_LOG_FATAL);
 #ifdef HAVE_AV_REGISTER_ALL
 	av_register_all ();
@@ -92,71 +211,110 @@ void BarPlayerInit (player_t * const p, const BarSettings_t * const settings) {
 	pthread_cond_init (&p->cond, NULL);
 	pthread_mutex_init (&p->aoplayLock, NULL);
 	pthread_cond_init (&p->aoplayCond, NULL);
-	BarPlayerReset (p);
+	pthread_cond_init (&p->jobCond, NULL);
+
+	/* non-blocking, the player must never wait for the main loop */
+	openPipe (p->notifyFd);
+	openPipe (p->wakeDecoder.fd);
+	openPipe (p->wakeOutput.fd);
+	p->wakeDecoder.waiting = false;
+	p->wakeOutput.waiting = false;
+	for (size_t i = 0; i < 2; i++) {
+		BarRingInit (&p->rings[i].ring);
+		p->rings[i].active = false;
+		p->rings[i].gain = 1;
+	}
+	p->ringW = 0;
+	BarMixInit (&p->mix);
+	BarOutputInit (&p->output, settings, p->wakeOutput.fd[0]);
+	p->aoBuf = NULL;
+	p->mixBuf = NULL;
+	p->aoBufSize = 0;
+	p->mixBufSize = 0;
+	BarSinksInit (&p->sinks);
+	p->sinksOpened = false;
+	p->sinkBuf = NULL;
+	p->sinkBufSize = 0;
+	p->httpd = NULL;
+	p->adtsValid = false;
+	p->volume = 1;
+
+	resetPlayer (p);
 	p->settings = settings;
+	p->throughput = 0;
+	p->bufferTarget = 0;
+	p->stableSecs = 0;
+	p->jobStart = 0;
+	p->jobCount = 0;
+	p->terminate = false;
+
+	pthread_create (&p->decoderThread, NULL, BarPlayerThread, p);
+	pthread_create (&p->aoThread, NULL, BarAoPlayThread, p);
 }
 
 void BarPlayerDestroy (player_t * const p) {
+	/* abort the current track and stop workers */
+	pthread_mutex_lock (&p->lock);
+	BarPlayerStore (p->terminate, true);
+	BarPlayerStore (p->doQuit, true);
+	BarPlayerStore (p->doPause, false);
+	pthread_cond_broadcast (&p->jobCond);
+	pthread_cond_broadcast (&p->cond);
+	pthread_mutex_unlock (&p->lock);
+	pthread_mutex_lock (&p->aoplayLock);
+	pthread_cond_broadcast (&p->aoplayCond);
+	pthread_mutex_unlock (&p->aoplayLock);
+	BarPlayerWakeup (p);
+	pthread_join (p->decoderThread, NULL);
+	pthread_mutex_lock (&p->aoplayLock);
+	pthread_cond_broadcast (&p->aoplayCond);
+	pthread_mutex_unlock (&p->aoplayLock);
+	pthread_join (p->aoThread, NULL);
+	BarOutputDestroy (&p->output);
+	BarSinksDestroy (&p->sinks);
+
+	pthread_cond_destroy (&p->jobCond);
 	pthread_cond_destroy (&p->cond);
 	pthread_mutex_destroy (&p->lock);
 	pthread_cond_destroy (&p->aoplayCond);
 	pthread_mutex_destroy (&p->aoplayLock);
+	closePipe (p->notifyFd);
+	closePipe (p->wakeDecoder.fd);
+	closePipe (p->wakeOutput.fd);
+	for (size_t i = 0; i < 2; i++) {
+		BarRingFree (&p->rings[i].ring);
+	}
+	free (p->aoBuf);
+	free (p->sinkBuf);
+	free (p->mixBuf);
+
+	reapWait ();
 
 #ifdef HAVE_AVFORMAT_NETWORK_INIT
 	avformat_network_deinit ();
 #endif
-	ao_shutdown ();
-}
-
-void BarPlayerReset (player_t * const p) {
-	p->doQuit = false;
-	p->doPause = false;
-	p->songDuration = 0;
-	p->songPlayed = 0;
-	p->mode = PLAYER_DEAD;
-	p->fvolume = NULL;
-	p->fgraph = NULL;
-	p->fctx = NULL;
-	p->st = NULL;
-	p->cctx = NULL;
-	p->fbufsink = NULL;
-	p->fabuf = NULL;
-	p->streamIdx = -1;
-	p->lastTimestamp = 0;
-	p->interrupted = 0;
-	p->aoDev = NULL;
 }
 
-/*	Update volume filter
+/*	Update output gain, picked up by the output worker with the next block.
+ *	The current track’s file gain is kept separately, since the previous
+ *	track may still be fading out.
  */
 void BarPlayerSetVolume (player_t * const player) {
 	assert (player != NULL);
 
-	if (player->mode != PLAYER_PLAYING) {
-		return;
-	}
-
-	int ret;
-#ifdef HAVE_AVFILTER_GRAPH_SEND_COMMAND
-	/* ffmpeg and libav disagree on the type of this option (string vs. double)
-	 * -> print to string and let them parse it again */
-	char strbuf[16];
-	snprintf (strbuf, sizeof (strbuf), "%fdB",
-			player->settings->volume + (player->gain * player->settings->gainMul));
-	assert (player->fgraph != NULL);
-	if ((ret = avfilter_graph_send_command (player->fgraph, "volume", "volume",
-					strbuf, NULL, 0, 0)) < 0) {
-#else
 	/* convert from decibel */
-	const double volume = pow (10, (player->settings->volume + (player->gain * player->settings->gainMul)) / 20);
-	/* libav does not provide other means to set this right now. it might not
-	 * even work everywhere. */
-	assert (player->fvolume != NULL);
-	if ((ret = av_opt_set_double (player->fvolume->priv, "volume", volume,
-			0)) != 0) {
-#endif
-		printError (player->settings, "Cannot set volume", ret);
-	}
+	const float volume = pow (10, player->settings->volume / 20.0);
+	const float gain = pow (10, player->gain * player->settings->gainMul / 20);
+	__atomic_store (&player->volume, &volume, __ATOMIC_RELEASE);
+	__atomic_store (&player->rings[BarPlayerLoad (player->ringW)].gain, &gain,
+			__ATOMIC_RELEASE);
+}
+
+/*	Operating on shared variables, called once per frame, so no locking
+ */
+
+static bool shouldQuit (player_t * const player) {
+	return BarPlayerLoad (player->doQuit);
 }
 
 #define softfail(msg) \
@@ -168,11 +326,12 @@ void BarPlayerSetVolume (player_t * const player) {
 static int intCb (void * const data) {
 	player_t * const player = data;
 	assert (player != NULL);
-	if (player->interrupted > 1) {
+	if (BarPlayerLoad (player->doQuit)) {
+		/* song skipped */
+		return 1;
+	} else if (player->interrupted > 1) {
 		/* got a sigint multiple times, quit pianobar (handled by main.c). */
-		pthread_mutex_lock (&player->lock);
-		player->doQuit = true;
-		pthread_mutex_unlock (&player->lock);
+		BarPlayerStore (player->doQuit, true);
 		return 1;
 	} else if (player->interrupted != 0) {
 		/* the request is retried with the same player context */
@@ -183,18 +342,15 @@ static int intCb (void * const data) {
 	}
 }
 
-static bool openStream (player_t * const player) {
-	assert (player != NULL);
-	/* no leak? */
-	assert (player->fctx == NULL);
-
+/*	Connect to url and start its fetch thread. *fetch must be closed and
+ *	freed by the caller, even on failure.
+ *	@return av error code
+ */
+static int openFetch (player_t * const player, BarFetch_t ** const fetch,
+		const char * const url) {
+	const AVIOInterruptCB cb = {intCb, player};
 	int ret;
 
-	/* stream setup */
-	player->fctx = avformat_alloc_context ();
-	player->fctx->interrupt_callback.callback = intCb;
-	player->fctx->interrupt_callback.opaque = player;
-
 	/* in microseconds */
 	unsigned long int timeout = player->settings->timeout*1000000;
 	char timeoutStr[16];
@@ -203,13 +359,158 @@ static bool openStream (player_t * const player) {
 	AVDictionary *options = NULL;
 	av_dict_set (&options, "timeout", timeoutStr, 0);
 
+	if ((*fetch = malloc (sizeof (**fetch))) == NULL) {
+		av_dict_free (&options);
+		return AVERROR (ENOMEM);
+	}
+	BarFetchInit (*fetch);
+	ret = BarFetchOpen (*fetch, url, &options, &cb,
+			player->settings->downloadBuffer);
+	av_dict_free (&options);
+	return ret;
+}
+
+static void *prefetchThread (void * const data) {
+	player_t * const player = data;
+	player->prefetchRet = openFetch (player, &player->prefetch,
+			player->urls[player->quality].url);
+	return NULL;
+}
+
+/*	Connect to the lower quality’s url in the background, openInput picks
+ *	it up
+ */
+static void prefetchStart (player_t * const player) {
+	assert (!player->prefetching);
+	player->prefetch = NULL;
+	player->prefetching = pthread_create (&player->prefetchThread, NULL,
+			prefetchThread, player) == 0;
+}
+
+/*	Wait for the background connection
+ *	@return av error code, player->prefetch is owned by the caller
+ */
+static int prefetchWait (player_t * const player) {
+	assert (player->prefetching);
+	pthread_join (player->prefetchThread, NULL);
+	player->prefetching = false;
+	return player->prefetchRet;
+}
+
+/*	Drop a background connection that was not used
+ */
+static void prefetchCancel (player_t * const player) {
+	if (player->prefetching) {
+		/* intCb aborts connecting if the track was skipped */
+		prefetchWait (player);
+		if (player->prefetch != NULL) {
+			BarFetchClose (player->prefetch);
+			free (player->prefetch);
+			player->prefetch = NULL;
+		}
+	}
+}
+
+/*	Open input and read stream parameters. If the format is known in advance
+ *	(fast open) the demuxer is forced and probing is limited.
+ *	@return av error code
+ */
+static int openInput (player_t * const player, const bool fast) {
+	/* demuxer for PianoAudioFormat_t */
+	static const char * const demuxers[] = {NULL, "mp4", "mp3"};
+	/* enough for a few frames */
+	static const int64_t fastProbeSize = 16*1024,
+			fastAnalyzeDuration = AV_TIME_BASE/10;
+	static const enum AVCodecID codecs[] = {AV_CODEC_ID_NONE, AV_CODEC_ID_AAC,
+			AV_CODEC_ID_MP3};
+	int ret;
+
+	/* stream setup */
+	player->fctx = avformat_alloc_context ();
+	player->fctx->interrupt_callback.callback = intCb;
+	player->fctx->interrupt_callback.opaque = player;
+
+	const AVInputFormat *fmt = NULL;
+	if (fast) {
+		assert (player->format < sizeof (demuxers) / sizeof (*demuxers));
+		fmt = av_find_input_format (demuxers[player->format]);
+		player->fctx->probesize = fastProbeSize;
+		player->fctx->max_analyze_duration = fastAnalyzeDuration;
+	}
+
+	/* the network connection is handled by the fetch thread */
 	assert (player->url != NULL);
-	if ((ret = avformat_open_input (&player->fctx, player->url, NULL, &options)) < 0) {
-		softfail ("Unable to open audio file");
+	assert (player->fetch == NULL);
+	if (player->prefetching) {
+		/* connected while the previous quality played out */
+		ret = prefetchWait (player);
+		player->fetch = player->prefetch;
+		player->prefetch = NULL;
+	} else {
+		ret = openFetch (player, &player->fetch, player->url);
 	}
+	if (ret < 0) {
+		avformat_free_context (player->fctx);
+		player->fctx = NULL;
+		return ret;
+	}
+	player->fctx->pb = player->fetch->pb;
+	player->fctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+	ret = avformat_open_input (&player->fctx, player->url, fmt, NULL);
+	if (ret < 0) {
+		return ret;
+	}
+
+	if (fast) {
+		/* the demuxer may know everything from the header already. Not so
+		 * for AAC: with implicit SBR/PS (AAC+) the header describes the core
+		 * stream only and the decoder doubles rate and channels, so a frame
+		 * must be decoded to find out. */
+		bool complete = player->fctx->nb_streams > 0;
+		for (size_t i = 0; i < player->fctx->nb_streams; i++) {
+			AVCodecParameters * const cp = player->fctx->streams[i]->codecpar;
+			if (cp->codec_id == AV_CODEC_ID_NONE) {
+				cp->codec_id = codecs[player->format];
+			}
+			complete = complete && cp->codec_id != AV_CODEC_ID_AAC &&
+					cp->sample_rate > 0 && cp->ch_layout.nb_channels > 0;
+		}
+		if (complete) {
+			return 0;
+		}
+	}
+
+	return avformat_find_stream_info (player->fctx, NULL);
+}
+
+static bool openStream (player_t * const player) {
+	assert (player != NULL);
+	/* no leak? */
+	assert (player->fctx == NULL);
+
+	int ret = -1;
 
-	if ((ret = avformat_find_stream_info (player->fctx, NULL)) < 0) {
-		softfail ("find_stream_info");
+	const bool fast = player->format != PIANO_AF_UNKNOWN;
+	if (fast) {
+		if ((ret = openInput (player, true)) < 0) {
+			debugPrint (DEBUG_AUDIO, "fast open failed with code %i (%s), "
+					"probing\n", ret, av_err2str (ret));
+			if (player->fctx != NULL) {
+				avformat_close_input (&player->fctx);
+			}
+			BarFetchClose (player->fetch);
+			free (player->fetch);
+			player->fetch = NULL;
+			if (shouldQuit (player)) {
+				return false;
+			}
+		}
+	}
+	if (!fast || ret < 0) {
+		if ((ret = openInput (player, false)) < 0) {
+			softfail ("Unable to open audio file");
+		}
 	}
 
 	/* ignore all streams, undone for audio stream below */
@@ -244,16 +545,17 @@ static bool openStream (player_t * const player) {
 		softfail ("codec_open2");
 	}
 
-	if (player->lastTimestamp > 0) {
-		av_seek_frame (player->fctx, player->streamIdx, player->lastTimestamp, 0);
+	/* the time base may differ if the quality changed */
+	if (player->resumeAt > 0) {
+		av_seek_frame (player->fctx, -1, player->resumeAt, 0);
+		player->lastTimestamp = av_rescale_q (player->resumeAt, AV_TIME_BASE_Q,
+				player->st->time_base);
 	}
 
 	const unsigned int songDuration = av_q2d (player->st->time_base) *
 			(double) player->st->duration;
-	pthread_mutex_lock (&player->lock);
-	player->songPlayed = 0;
-	player->songDuration = songDuration;
-	pthread_mutex_unlock (&player->lock);
+	BarPlayerStore (player->songPlayed, 0);
+	BarPlayerStore (player->songDuration, songDuration);
 
 	return true;
 }
@@ -267,6 +569,18 @@ static int getSampleRate (const player_t * const player) {
 			player->settings->sampleRate;
 }
 
+/*	Samples per ring block and device write. audio_period trades latency for
+ *	fewer wakeups.
+ */
+static unsigned int getBlockSamples (const player_t * const player) {
+	const unsigned int period = player->settings->audioPeriod;
+	if (period == 0) {
+		return defaultBlockSamples;
+	}
+	const unsigned int samples = (uint64_t) getSampleRate (player) * period / 1000;
+	return samples > 0 ? samples : 1;
+}
+
 /*	setup filter chain
  */
 static bool openFilter (player_t * const player) {
@@ -295,14 +609,8 @@ static bool openFilter (player_t * const player) {
 		softfail ("create_filter abuffer");
 	}
 
-	/* volume */
-	if ((ret = avfilter_graph_create_filter (&player->fvolume,
-			avfilter_get_by_name ("volume"), "volume", "0dB", NULL,
-			player->fgraph)) < 0) {
-		softfail ("create_filter volume");
-	}
-
-	/* aformat: convert float samples into something more usable */
+	/* aformat: planar float for BarMixConvert, which also applies the volume.
+	 * No-op for most decoders, unless the sample rate is changed. */
 	AVFilterContext *fafmt = NULL;
 	snprintf (strbuf, sizeof (strbuf), "sample_fmts=%s:sample_rates=%d",
 			av_get_sample_fmt_name (avformat), getSampleRate (player));
@@ -319,9 +627,8 @@ static bool openFilter (player_t * const player) {
 		softfail ("create_filter abuffersink");
 	}
 
-	/* connect filter: abuffer -> volume -> aformat -> abuffersink */
-	if (avfilter_link (player->fabuf, 0, player->fvolume, 0) != 0 ||
-			avfilter_link (player->fvolume, 0, fafmt, 0) != 0 ||
+	/* connect filter: abuffer -> aformat -> abuffersink */
+	if (avfilter_link (player->fabuf, 0, fafmt, 0) != 0 ||
 			avfilter_link (fafmt, 0, player->fbufsink, 0) != 0) {
 		softfail ("filter_link");
 	}
@@ -330,219 +637,1060 @@ static bool openFilter (player_t * const player) {
 		softfail ("graph_config");
 	}
 
+	/* one frame per ring block */
+	av_buffersink_set_frame_size (player->fbufsink, getBlockSamples (player));
+
 	return true;
 }
 
-/*	setup libao
+/*	Open the audio device for the current track, the previous track’s is
+ *	reused if the format did not change
  */
 static bool openDevice (player_t * const player) {
-	const AVCodecParameters * const cp = player->st->codecpar;
+	return BarOutputOpen (&player->output, getSampleRate (player),
+			player->st->codecpar->ch_layout.nb_channels);
+}
 
-	ao_sample_format aoFmt;
-	memset (&aoFmt, 0, sizeof (aoFmt));
-	aoFmt.bits = av_get_bytes_per_sample (avformat) * 8;
-	assert (aoFmt.bits > 0);
-	aoFmt.channels = cp->ch_layout.nb_channels;
-	aoFmt.rate = getSampleRate (player);
-	aoFmt.byte_format = AO_FMT_NATIVE;
-
-	int driver = -1;
-	if (player->settings->audioPipe) {
-		// using audio pipe
-		struct stat st;
-		if (stat (player->settings->audioPipe, &st)) {
-			BarUiMsg (player->settings, MSG_ERR, "Cannot stat audio pipe file.\n");
-			return false;
-		}
-		if (!S_ISFIFO (st.st_mode)) {
-			BarUiMsg (player->settings, MSG_ERR, "File is not a pipe, error.\n");
-			return false;
-		}
-		driver = ao_driver_id ("raw");
-		if ((player->aoDev = ao_open_file(driver, player->settings->audioPipe, 1, &aoFmt, NULL)) == NULL) {
-			BarUiMsg (player->settings, MSG_ERR, "Cannot open audio pipe file.\n");
-			return false;
-		}
-	} else {
-		// use driver from libao configuration
-		driver = ao_default_driver_id ();
-		if ((player->aoDev = ao_open_live (driver, &aoFmt, NULL)) == NULL) {
-			BarUiMsg (player->settings, MSG_ERR, "Cannot open audio device.\n");
-			return false;
+/*	Wake up the main loop
+ */
+static void notify (player_t * const player) {
+	if (player->notifyFd[1] != -1) {
+		const char c = 0;
+		/* a full pipe is fine, the main loop will wake up anyway */
+		if (write (player->notifyFd[1], &c, sizeof (c)) == -1) {
+			assert (errno == EAGAIN || errno == EWOULDBLOCK);
 		}
 	}
+}
 
-	return true;
+static void changeMode (player_t * const player, BarPlayerMode mode) {
+	BarPlayerStore (player->mode, mode);
+	notify (player);
 }
 
-/*	Operating on shared variables and must be protected by mutex
+/*	Consume pending notifications, called by the main loop
  */
+void BarPlayerClearNotify (player_t * const player) {
+	char buf[64];
+	if (player->notifyFd[0] != -1) {
+		while (read (player->notifyFd[0], buf, sizeof (buf)) > 0);
+	}
+}
 
-static bool shouldQuit (player_t * const player) {
-	pthread_mutex_lock (&player->lock);
-	const bool ret = player->doQuit;
-	pthread_mutex_unlock (&player->lock);
-	return ret;
+BarPlayerMode BarPlayerGetMode (player_t * const player) {
+	return BarPlayerLoad (player->mode);
 }
 
-static void changeMode (player_t * const player, unsigned int mode) {
-	pthread_mutex_lock (&player->lock);
-	player->mode = mode;
-	pthread_mutex_unlock (&player->lock);
+static void listAppend (BarPlayerQueue_t * const q, BarPlayerPacket_t * const e) {
+	e->next = NULL;
+	if (q->tail == NULL) {
+		q->head = e;
+	} else {
+		q->tail->next = e;
+	}
+	q->tail = e;
+	q->duration += e->pkt->duration;
+	q->bytes += e->pkt->size;
 }
 
-BarPlayerMode BarPlayerGetMode (player_t * const player) {
-	pthread_mutex_lock (&player->lock);
-	const BarPlayerMode ret = player->mode;
-	pthread_mutex_unlock (&player->lock);
-	return ret;
+static BarPlayerPacket_t *listShift (BarPlayerQueue_t * const q) {
+	BarPlayerPacket_t * const e = q->head;
+
+	if (e == NULL) {
+		return NULL;
+	}
+	q->head = e->next;
+	if (q->head == NULL) {
+		q->tail = NULL;
+	}
+	q->duration -= e->pkt->duration;
+	q->bytes -= e->pkt->size;
+	e->next = NULL;
+	return e;
 }
 
-/*	decode and play stream. returns 0 or av error code.
+static void listFree (BarPlayerQueue_t * const q) {
+	BarPlayerPacket_t *e;
+	while ((e = listShift (q)) != NULL) {
+		av_packet_free (&e->pkt);
+		free (e);
+	}
+	memset (q, 0, sizeof (*q));
+}
+
+/*	Append packet to read-ahead queue, takes ownership of pkt’s data
  */
-static int play (player_t * const player) {
-	assert (player != NULL);
-	const int64_t minBufferHealth = player->settings->bufferSecs;
-	AVCodecContext * const cctx = player->cctx;
+static void queuePush (player_t * const player, AVPacket * const pkt) {
+	const AVCodecParameters * const cp = player->st->codecpar;
 
-	AVPacket *pkt = av_packet_alloc ();
-	assert (pkt != NULL);
-	pkt->data = NULL;
-	pkt->size = 0;
+	BarPlayerPacket_t * const e = malloc (sizeof (*e));
+	assert (e != NULL);
+	e->pkt = av_packet_alloc ();
+	assert (e->pkt != NULL);
+	av_packet_move_ref (e->pkt, pkt);
 
-	AVFrame *frame = NULL;
-	frame = av_frame_alloc ();
-	assert (frame != NULL);
-	pthread_t aoplaythread;
-	pthread_create (&aoplaythread, NULL, BarAoPlayThread, player);
-	enum { FILL, DRAIN, DONE } drainMode = FILL;
-	int ret = 0;
-	const double timeBase = av_q2d (player->st->time_base);
-	while (!shouldQuit (player) && drainMode != DONE) {
-		if (drainMode == FILL) {
-			ret = av_read_frame (player->fctx, pkt);
-			if (ret == AVERROR_EOF) {
-				/* enter drain mode */
-				drainMode = DRAIN;
-				avcodec_send_packet (cctx, NULL);
-				debugPrint (DEBUG_AUDIO, "decoder entering drain mode after EOF\n");
-			} else if (pkt->stream_index != player->streamIdx) {
-				/* unused packet */
-				av_packet_unref (pkt);
-				continue;
-			} else if (ret < 0) {
-				/* error, abort */
-				/* mark the EOF, so that BarAoPlayThread can quit*/
-				char error[AV_ERROR_MAX_STRING_SIZE];
-				if (av_strerror(ret, error, sizeof(error)) < 0) {
-					strncpy (error, "(unknown)", sizeof(error)-1);
-				}
-				debugPrint (DEBUG_AUDIO, "av_read_frame failed with code %i (%s), "
-						"sending NULL frame\n", ret, error);
-				pthread_mutex_lock (&player->aoplayLock);
-				const int rt = av_buffersrc_add_frame (player->fabuf, NULL);
-				assert (rt == 0);
-				pthread_cond_broadcast (&player->aoplayCond);
-				pthread_mutex_unlock (&player->aoplayLock);
-				break;
-			} else {
-				/* fill buffer */
-				avcodec_send_packet (cctx, pkt);
-			}
-		}
+	/* not all demuxers provide a duration, assume one codec frame */
+	if (e->pkt->duration <= 0 && cp->frame_size > 0 && cp->sample_rate > 0) {
+		e->pkt->duration = av_rescale_q (cp->frame_size,
+				(AVRational) {1, cp->sample_rate}, player->st->time_base);
+	}
 
-		while (!shouldQuit (player)) {
-			ret = avcodec_receive_frame (cctx, frame);
-			if (ret == AVERROR_EOF) {
-				/* done draining */
-				drainMode = DONE;
-				/* mark the EOF*/
-				debugPrint (DEBUG_AUDIO, "receive_frame got EOF, sending NULL frame\n");
-				pthread_mutex_lock (&player->aoplayLock);
-				const int rt = av_buffersrc_add_frame (player->fabuf, NULL);
-				assert (rt == 0);
-				pthread_cond_broadcast (&player->aoplayCond);
-				pthread_mutex_unlock (&player->aoplayLock);
-				break;
-			} else if (ret != 0) {
-				/* no more output */
-				break;
-			}
+	listAppend (&player->queue, e);
+}
 
-			/* XXX: suppresses warning from resample filter */
-			if (frame->pts == (int64_t) AV_NOPTS_VALUE) {
-				frame->pts = 0;
-			}
-			pthread_mutex_lock (&player->aoplayLock);
-			ret = av_buffersrc_write_frame (player->fabuf, frame);
-			assert (ret >= 0);
-			pthread_mutex_unlock (&player->aoplayLock);
-			
-			int64_t bufferHealth = 0;
-			do {
-				pthread_mutex_lock (&player->aoplayLock);
-				bufferHealth = timeBase * (double) (frame->pts - player->lastTimestamp);
-				if (bufferHealth > minBufferHealth) {
-					debugPrint (DEBUG_AUDIO, "decoding buffer filled health %"PRIi64" minHealth %"PRIi64"\n",
-							bufferHealth, minBufferHealth);
-					/* Buffer get healthy, resume */
-					pthread_cond_broadcast (&player->aoplayCond);
-					/* Buffer is healthy enough, wait */
-					pthread_cond_wait (&player->aoplayCond, &player->aoplayLock);
-					debugPrint (DEBUG_AUDIO, "ao play signalled it needs more data health %"PRIi64" minHealth %"PRIi64"\n",
-							bufferHealth, minBufferHealth);
-				}
-				pthread_mutex_unlock (&player->aoplayLock);
-			} while (bufferHealth > minBufferHealth);
-		}
+/*	Remove first packet from read-ahead queue. It is kept for seeking back,
+ *	up to buffer_seconds_max, and must not be freed by the caller.
+ */
+static AVPacket *queuePop (player_t * const player) {
+	BarPlayerQueue_t * const played = &player->played;
+	const BarSettings_t * const settings = player->settings;
+	BarPlayerPacket_t * const e = listShift (&player->queue);
 
-		av_packet_unref (pkt);
+	if (e == NULL) {
+		return NULL;
+	}
+	listAppend (played, e);
+
+	const int64_t keep = av_rescale_q (settings->bufferMaxSecs,
+			(AVRational) {1, 1}, player->st->time_base);
+	while (played->head != e && (played->duration > keep ||
+			(settings->bufferBytes > 0 && played->bytes > settings->bufferBytes))) {
+		BarPlayerPacket_t *old = listShift (played);
+		av_packet_free (&old->pkt);
+		free (old);
 	}
-	av_frame_free (&frame);
-	av_packet_free (&pkt);
-	debugPrint (DEBUG_AUDIO, "decoder is done, waiting for ao player\n");
-	pthread_join (aoplaythread, NULL);
 
-	return ret;
+	return e->pkt;
 }
 
-static void finish (player_t * const player) {
-	ao_close (player->aoDev);
-	player->aoDev = NULL;
-	if (player->fgraph != NULL) {
-		avfilter_graph_free (&player->fgraph);
-		player->fgraph = NULL;
+static void queueFlush (player_t * const player) {
+	listFree (&player->queue);
+	listFree (&player->played);
+}
+
+/*	Move all packets with pts before ts into played, the remaining ones, and
+ *	the one containing ts, are decoded next
+ */
+static void queueSplit (player_t * const player, const int64_t ts) {
+	BarPlayerQueue_t * const played = &player->played,
+			* const q = &player->queue;
+
+	if (played->tail != NULL) {
+		played->tail->next = q->head;
 	}
-	if (player->cctx != NULL) {
-		avcodec_free_context (&player->cctx);
-		player->cctx = NULL;
+	BarPlayerPacket_t *e = played->head != NULL ? played->head : q->head;
+	memset (played, 0, sizeof (*played));
+	memset (q, 0, sizeof (*q));
+
+	bool split = false;
+	while (e != NULL) {
+		BarPlayerPacket_t * const next = e->next;
+		split = split || next == NULL || next->pkt->pts > ts;
+		listAppend (split ? q : played, e);
+		e = next;
 	}
-	if (player->fctx != NULL) {
-		avformat_close_input (&player->fctx);
+}
+
+/*	Current buffer size in seconds, within buffer_seconds_min and
+ *	buffer_seconds_max
+ */
+static unsigned int getBufferTarget (player_t * const player) {
+	const BarSettings_t * const settings = player->settings;
+	unsigned int target = BarPlayerLoad (player->bufferTarget);
+	if (target == 0) {
+		target = settings->bufferSecs;
+		if (target < settings->bufferMinSecs) {
+			target = settings->bufferMinSecs;
+		}
+		if (target > settings->bufferMaxSecs) {
+			target = settings->bufferMaxSecs;
+		}
+		BarPlayerStore (player->bufferTarget, target);
 	}
+	return target;
 }
 
-/*	player thread; for every song a new thread is started
- *	@param audioPlayer structure
- *	@return PLAYER_RET_*
+/*	Buffer ran dry, double its size
  */
-void *BarPlayerThread (void *data) {
-	assert (data != NULL);
+static void bufferUnderrun (player_t * const player) {
+	const unsigned int target = getBufferTarget (player),
+			max = player->settings->bufferMaxSecs;
+	const unsigned int grown = target == 0 ? 1 : target*2;
+	BarPlayerStore (player->bufferTarget, grown > max ? max : grown);
+	player->stableSecs = 0;
+	debugPrint (DEBUG_AUDIO, "underrun, buffer target is %u s now\n",
+			BarPlayerLoad (player->bufferTarget));
+}
 
-	player_t * const player = data;
-	uintptr_t pret = PLAYER_RET_OK;
+/*	Played secs without underrun. Shrink buffer by a second every minute.
+ */
+static void bufferStable (player_t * const player, const double secs) {
+	static const double shrinkAfter = 60;
+	player->stableSecs += secs;
+	if (player->stableSecs >= shrinkAfter) {
+		const unsigned int target = getBufferTarget (player);
+		if (target > player->settings->bufferMinSecs) {
+			BarPlayerStore (player->bufferTarget, target-1);
+		}
+		player->stableSecs = 0;
+	}
+}
 
-	bool retry;
-	do {
-		retry = false;
-		if (openStream (player)) {
-			if (openFilter (player) && openDevice (player)) {
-				changeMode (player, PLAYER_PLAYING);
-				BarPlayerSetVolume (player);
-				const int ret = play (player);
-				retry = (ret == AVERROR_INVALIDDATA ||
-						 ret == -ECONNRESET) &&
-						!player->interrupted;
+/*	Seconds of PCM decoded ahead of the output. Enough to cover decoding
+ *	latency, or to let the decoder refill the ring in bursts with large
+ *	periods.
+ */
+static double getPcmAhead (player_t * const player) {
+	const unsigned int bufferTarget = getBufferTarget (player);
+	const unsigned int period = player->settings->audioPeriod;
+	const unsigned int crossfade = player->settings->crossfade;
+	double ahead = bufferTarget < 1 ? bufferTarget : 1;
+	if (period > 0) {
+		ahead = period * 3 / 1000.0;
+	}
+	/* the whole tail must be decoded before the next track can start */
+	if (crossfade > 0 && crossfade + 1 > ahead) {
+		ahead = crossfade + 1;
+	}
+	return ahead;
+}
+
+/*	Wait until the output worker is done with the decoder’s ring, and with
+ *	the other one too if all is set
+ */
+static void waitOutput (player_t * const player, const bool all) {
+	const BarPlayerRing_t * const rings = player->rings;
+	const unsigned int w = player->ringW;
+
+	pthread_mutex_lock (&player->aoplayLock);
+	while (rings[w].active || (all && rings[!w].active)) {
+		pthread_cond_wait (&player->aoplayCond, &player->aoplayLock);
+	}
+	pthread_mutex_unlock (&player->aoplayLock);
+}
+
+/*	Grow buf to at least size bytes, contents are lost
+ *	@return buffer, NULL if out of memory
+ */
+static void *growBuffer (void * const buf, size_t * const bufSize,
+		const size_t size, const bool lock) {
+	if (size <= *bufSize) {
+		return buf;
+	}
+	free (buf);
+	void * const newBuf = malloc (size);
+	if (newBuf == NULL) {
+		*bufSize = 0;
+		return NULL;
+	}
+	/* prefault */
+	memset (newBuf, 0, size);
+	*bufSize = size;
+	if (lock) {
+		mlock (newBuf, size);
+	}
+	return newBuf;
+}
+
+/*	Allocate ring blocks for pcmAhead seconds of audio
+ */
+static bool openRing (player_t * const player) {
+	const AVCodecParameters * const cp = player->st->codecpar;
+	const BarSettings_t * const settings = player->settings;
+	const unsigned int samples = getBlockSamples (player);
+	const int channels = cp->ch_layout.nb_channels;
+
+	if (channels <= 0 || channels > BAR_MIX_MAXCHANNELS) {
+		BarUiMsg (settings, MSG_ERR, "Unsupported number of channels (%i).\n",
+				channels);
+		return false;
+	}
+
+	if (settings->audioSinks != NULL && !player->sinksOpened) {
+		/* first track, the output worker is idle */
+		player->sinksOpened = true;
+		if (!BarSinksOpen (&player->sinks, settings->audioSinks)) {
+			BarUiMsg (settings, MSG_ERR, "Invalid audio_sinks, ignoring them.\n");
+			BarSinksDestroy (&player->sinks);
+		}
+	}
+	const bool sinks = player->sinks.count > 0;
+
+	const size_t blockSize = samples * channels *
+			av_get_bytes_per_sample (avformat);
+	/* one block, converted to the device format (any of them, the format is
+	 * only known after opening the device) and for mixing */
+	const size_t aoBufSize = samples * channels * sizeof (int32_t),
+			mixBufSize = samples * channels * sizeof (float);
+
+	/* the previous track may still be playing, unless the device or the
+	 * output buffers change */
+	const bool overlap = BarOutputCanReuse (&player->output,
+			getSampleRate (player), channels) &&
+			aoBufSize <= player->aoBufSize && mixBufSize <= player->mixBufSize &&
+			(!sinks || aoBufSize <= player->sinkBufSize);
+	waitOutput (player, !overlap);
+
+	size_t blocks = ceil (getPcmAhead (player) * getSampleRate (player) /
+			samples) + 1;
+	if (blocks < 2) {
+		blocks = 2;
+	}
+	const bool lock = settings->audioRealtime;
+	if (!BarRingAlloc (&player->rings[player->ringW].ring, blocks, blockSize,
+			lock) ||
+			(player->aoBuf = growBuffer (player->aoBuf, &player->aoBufSize,
+			aoBufSize, lock)) == NULL ||
+			(player->mixBuf = growBuffer (player->mixBuf, &player->mixBufSize,
+			mixBufSize, lock)) == NULL ||
+			(sinks && (player->sinkBuf = growBuffer (player->sinkBuf,
+			&player->sinkBufSize, aoBufSize, lock)) == NULL)) {
+		BarUiMsg (settings, MSG_ERR, "Out of memory.\n");
+		return false;
+	}
+	/* without period the decoder tops up every block, otherwise it waits
+	 * until half of the ring is free */
+	player->ringLow = settings->audioPeriod > 0 ? blocks/2 : blocks-1;
+
+	return true;
+}
+
+/*	Read-ahead limit reached? An empty queue is never full.
+ */
+static bool queueFull (player_t * const player) {
+	const BarPlayerQueue_t * const q = &player->queue;
+	const BarSettings_t * const settings = player->settings;
+
+	if (q->head == NULL) {
+		return false;
+	}
+	if (BarPlayerLoad (player->doPause)) {
+		/* keep downloading the whole track while paused, so the connection
+		 * does not time out and playback resumes from memory */
+		return settings->bufferBytes > 0 && q->bytes >= settings->bufferBytes;
+	}
+	return av_q2d (player->st->time_base) * (double) q->duration >=
+			getBufferTarget (player) ||
+			(settings->bufferBytes > 0 && q->bytes >= settings->bufferBytes);
+}
+
+/*	Nominal bitrate in kbit/s, if the server did not tell us
+ */
+static unsigned int getBitrate (const PianoAudioUrl_t * const urls,
+		const PianoAudioQuality_t q) {
+	static const unsigned int nominal[] = {0, 32, 64, 192};
+	return urls[q].bitrate != 0 ? urls[q].bitrate : nominal[q];
+}
+
+/*	Pick audio url for song. With audio_quality = auto the best quality that
+ *	fits the measured throughput is used.
+ */
+void BarPlayerSelectAudio (player_t * const player, BarPlayerJob_t * const job,
+		const PianoSong_t * const song) {
+	assert (player != NULL);
+	assert (job != NULL);
+	assert (song != NULL);
+
+	job->url = song->audioUrl;
+	job->format = song->audioFormat;
+	job->urls = NULL;
+	job->quality = PIANO_AQ_UNKNOWN;
+	if (player->settings->audioQuality != PIANO_AQ_UNKNOWN) {
+		return;
+	}
+
+	const unsigned int throughput = BarPlayerLoad (player->throughput);
+	PianoAudioQuality_t best = PIANO_AQ_UNKNOWN;
+	for (PianoAudioQuality_t q = PIANO_AQ_HIGH; q > PIANO_AQ_UNKNOWN; q--) {
+		if (song->audio[q].url == NULL) {
+			continue;
+		}
+		best = q;
+		/* leave some headroom */
+		if (throughput == 0 || getBitrate (song->audio, q)*5/4 <= throughput) {
+			break;
+		}
+	}
+	if (best != PIANO_AQ_UNKNOWN) {
+		job->urls = song->audio;
+		job->quality = best;
+		job->url = song->audio[best].url;
+		job->format = song->audio[best].format;
+		debugPrint (DEBUG_AUDIO, "selected quality %i for throughput %u kbit/s\n",
+				best, throughput);
+	}
+}
+
+/*	Is the link too slow for the current quality? Then pick a lower one.
+ */
+static bool shouldDowngrade (player_t * const player,
+		const unsigned int underruns, const double bufferHealth) {
+	if (player->urls == NULL) {
+		return false;
+	}
+
+	PianoAudioQuality_t lower = player->quality - 1;
+	while (lower > PIANO_AQ_UNKNOWN && player->urls[lower].url == NULL) {
+		--lower;
+	}
+	const unsigned int throughput = BarPlayerLoad (player->fetch->throughput);
+	if (lower == PIANO_AQ_UNKNOWN || throughput == 0) {
+		return false;
+	}
+
+	const unsigned int bitrate = getBitrate (player->urls, player->quality);
+	const bool starved = BarPlayerLoad (player->underrunsTotal) != underruns;
+	if ((starved && throughput < bitrate) || (throughput*10 < bitrate*9 &&
+			bufferHealth < getBufferTarget (player) / 2.0)) {
+		debugPrint (DEBUG_AUDIO, "downgrading to quality %i, throughput %u "
+				"kbit/s, bitrate %u kbit/s\n", lower, throughput, bitrate);
+		BarUiMsg (player->settings, MSG_INFO,
+				"Network too slow, switching to lower audio quality.\n");
+		player->quality = lower;
+		return true;
+	}
+	return false;
+}
+
+/*	Signal EOF to the filter graph, pullSink passes it on to BarAoPlayThread
+ */
+static void sendEof (player_t * const player) {
+	const int rt = av_buffersrc_add_frame (player->fabuf, NULL);
+	assert (rt == 0);
+}
+
+/*	Announce that the caller is about to sleep in sleepOn. The condition
+ *	must be checked again afterwards to avoid missing wakeUp.
+ */
+static void sleepPrepare (BarPlayerWake_t * const w) {
+	__atomic_store_n (&w->waiting, true, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence (__ATOMIC_SEQ_CST);
+}
+
+/*	Sleep until wakeUp or timeout, if sleep is set
+ */
+static void sleepOn (BarPlayerWake_t * const w, const bool sleep,
+		const int timeoutMs) {
+	if (sleep) {
+		if (w->fd[0] != -1) {
+			struct pollfd pfd = {.fd = w->fd[0], .events = POLLIN};
+			poll (&pfd, 1, timeoutMs);
+			char buf[16];
+			while (read (w->fd[0], buf, sizeof (buf)) > 0);
+		} else {
+			const struct timespec ts = {.tv_sec = timeoutMs / 1000,
+					.tv_nsec = (timeoutMs % 1000) * 1000000L};
+			nanosleep (&ts, NULL);
+		}
+	}
+	__atomic_store_n (&w->waiting, false, __ATOMIC_SEQ_CST);
+}
+
+/*	Wake up the other side, a single write() and only if it is sleeping
+ */
+static void wakeUp (BarPlayerWake_t * const w) {
+	__atomic_thread_fence (__ATOMIC_SEQ_CST);
+	if (__atomic_load_n (&w->waiting, __ATOMIC_SEQ_CST) && w->fd[1] != -1) {
+		const char c = 0;
+		/* a full pipe is fine, the other side will wake up anyway */
+		if (write (w->fd[1], &c, sizeof (c)) == -1) {
+			assert (errno == EAGAIN || errno == EWOULDBLOCK);
+		}
+	}
+}
+
+/*	Workers returned from a blocking call
+ */
+static void countWakeup (player_t * const player) {
+	__atomic_add_fetch (&player->wakeups, 1, __ATOMIC_RELAXED);
+}
+
+static int64_t monotonicUs (void) {
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+/*	Update the position seqlock. The output worker must not wait for the
+ *	decoder and skips the update instead, the next block corrects it.
+ */
+static void positionSet (BarPlayerPosition_t * const p, const bool wait,
+		const uint64_t written, const uint64_t heard, const unsigned int rate) {
+	unsigned int seq;
+	for (;;) {
+		seq = __atomic_load_n (&p->seq, __ATOMIC_RELAXED);
+		if (!(seq & 1) && __atomic_compare_exchange_n (&p->seq, &seq, seq + 1,
+				false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			break;
+		} else if (!wait) {
+			return;
+		}
+	}
+	__atomic_store_n (&p->written, written, __ATOMIC_RELAXED);
+	__atomic_store_n (&p->heard, heard, __ATOMIC_RELAXED);
+	__atomic_store_n (&p->rate, rate, __ATOMIC_RELAXED);
+	__atomic_store_n (&p->at, monotonicUs (), __ATOMIC_RELAXED);
+	__atomic_store_n (&p->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/*	Samples heard now, extrapolated from the last update, but never beyond
+ *	the samples written to the device
+ */
+static uint64_t positionGet (const BarPlayerPosition_t * const p,
+		unsigned int * const rate) {
+	unsigned int seq;
+	uint64_t written, heard;
+	int64_t at;
+	do {
+		seq = __atomic_load_n (&p->seq, __ATOMIC_ACQUIRE);
+		written = __atomic_load_n (&p->written, __ATOMIC_RELAXED);
+		heard = __atomic_load_n (&p->heard, __ATOMIC_RELAXED);
+		*rate = __atomic_load_n (&p->rate, __ATOMIC_RELAXED);
+		at = __atomic_load_n (&p->at, __ATOMIC_RELAXED);
+		__atomic_thread_fence (__ATOMIC_ACQUIRE);
+	} while ((seq & 1) || seq != __atomic_load_n (&p->seq, __ATOMIC_RELAXED));
+
+	const int64_t elapsedUs = monotonicUs () - at;
+	if (elapsedUs > 0) {
+		heard += (uint64_t) elapsedUs * *rate / 1000000;
+	}
+	return heard < written ? heard : written;
+}
+
+/*	Position of the current track as heard in milliseconds. Lock-free, can
+ *	be polled from any thread.
+ */
+unsigned int BarPlayerGetPositionMs (const player_t * const player) {
+	unsigned int rate;
+	const uint64_t heard = positionGet (&player->position, &rate);
+	return rate > 0 ? heard * 1000 / rate : 0;
+}
+
+/*	Interrupt both workers’ sleep, for skipping
+ */
+void BarPlayerWakeup (player_t * const player) {
+	const char c = 0;
+	/* full pipes are fine, the workers will wake up anyway */
+	if (player->wakeDecoder.fd[1] != -1 &&
+			write (player->wakeDecoder.fd[1], &c, sizeof (c)) == -1) {
+		assert (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+	if (player->wakeOutput.fd[1] != -1 &&
+			write (player->wakeOutput.fd[1], &c, sizeof (c)) == -1) {
+		assert (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
+}
+
+/*	Move filtered audio into free ring blocks
+ *	@return true if EOF was handed over
+ */
+static bool pullSink (player_t * const player, AVFrame * const frame) {
+	BarRing_t * const ring = &player->rings[player->ringW].ring;
+	const double timeBase = av_q2d (av_buffersink_get_time_base (player->fbufsink));
+
+	BarRingBlock_t *b;
+	while ((b = BarRingWritable (ring)) != NULL) {
+		const int ret = av_buffersink_get_frame (player->fbufsink, frame);
+		if (ret == AVERROR_EOF) {
+			b->len = 0;
+			b->eof = true;
+			b->epoch = player->rings[player->ringW].epoch;
+			BarRingPush (ring);
+			wakeUp (&player->wakeOutput);
+			return true;
+		} else if (ret < 0) {
+			return false;
+		}
+
+		/* planes are stored back to back */
+		assert (frame->format == avformat);
+		const int channels = frame->ch_layout.nb_channels;
+		const size_t plane = frame->nb_samples * sizeof (float);
+		assert (plane * channels <= ring->blockSize);
+		for (int c = 0; c < channels; c++) {
+			memcpy (&b->data[c*plane], frame->extended_data[c], plane);
+		}
+		b->len = plane * channels;
+		b->eof = false;
+		b->epoch = player->rings[player->ringW].epoch;
+		b->timestamp = (double) frame->pts * timeBase;
+		if (player->httpd != NULL &&
+				BarHttpdListening (player->httpd, BAR_HTTPD_PCM)) {
+			BarHttpdPcm (player->httpd,
+					(const float * const *) frame->extended_data,
+					frame->nb_samples);
+		}
+		av_frame_unref (frame);
+		BarRingPush (ring);
+		wakeUp (&player->wakeOutput);
+	}
+	return false;
+}
+
+/*	Announce the track’s formats to httpd. AAC frames from mp4 get ADTS
+ *	headers, so they can be concatenated and joined at any frame.
+ */
+static void httpdStart (player_t * const player) {
+	BarHttpd_t * const httpd = player->httpd;
+	const AVCodecParameters * const cp = player->st->codecpar;
+
+	player->adtsValid = false;
+	if (httpd == NULL) {
+		return;
+	}
+
+	BarHttpdPcmFormat (httpd, getSampleRate (player),
+			cp->ch_layout.nb_channels);
+
+	const char *contentType = NULL;
+	if (cp->codec_id == AV_CODEC_ID_MP3) {
+		contentType = "audio/mpeg";
+	} else if (cp->codec_id == AV_CODEC_ID_AAC && cp->extradata_size >= 2) {
+		/* AudioSpecificConfig: object type (5 bits), sampling frequency
+		 * index (4), channel configuration (4). With explicit SBR signalling
+		 * the extension rate and core object type follow, ADTS describes
+		 * the core. */
+		uint32_t asc = 0;
+		for (int i = 0; i < 4; i++) {
+			asc = (asc << 8) | (i < cp->extradata_size ? cp->extradata[i] : 0);
+		}
+		unsigned int type = asc >> 27, freq = (asc >> 23) & 0xf;
+		const unsigned int chan = (asc >> 19) & 0xf;
+		if ((type == 5 || type == 29) && cp->extradata_size >= 3) {
+			type = (asc >> 10) & 0x1f;
+		}
+		if (type >= 1 && type <= 4 && freq < 13) {
+			uint8_t * const h = player->adts;
+			h[0] = 0xff;
+			/* MPEG-4, no CRC */
+			h[1] = 0xf1;
+			h[2] = ((type - 1) << 6) | (freq << 2) | (chan >> 2);
+			h[3] = (chan & 3) << 6;
+			h[4] = 0;
+			/* buffer fullness 0x7ff (variable rate) */
+			h[5] = 0x1f;
+			h[6] = 0xfc;
+			player->adtsValid = true;
+			contentType = "audio/aac";
+		}
+	}
+	BarHttpdFormat (httpd, BAR_HTTPD_COMPRESSED, contentType);
+}
+
+/*	Pass a compressed frame to httpd
+ */
+static void httpdPacket (player_t * const player, const AVPacket * const p) {
+	BarHttpd_t * const httpd = player->httpd;
+
+	if (httpd == NULL || !BarHttpdListening (httpd, BAR_HTTPD_COMPRESSED)) {
+		return;
+	}
+	if (player->st->codecpar->codec_id == AV_CODEC_ID_MP3) {
+		BarHttpdWrite (httpd, BAR_HTTPD_COMPRESSED, NULL, 0, p->data, p->size);
+	} else if (player->adtsValid) {
+		const size_t len = sizeof (player->adts) + p->size;
+		/* 13 bit frame length */
+		if (len < 8192) {
+			uint8_t h[sizeof (player->adts)];
+			memcpy (h, player->adts, sizeof (h));
+			h[3] |= len >> 11;
+			h[4] = (len >> 3) & 0xff;
+			h[5] |= (len & 7) << 5;
+			BarHttpdWrite (httpd, BAR_HTTPD_COMPRESSED, h, sizeof (h), p->data,
+					p->size);
+		}
+	}
+}
+
+/*	Seek the current track by delta seconds. Targets within the packets
+ *	in memory are decoded from there immediately. Otherwise the demuxer
+ *	seeks, which the fetch thread serves from its ring or with a range
+ *	request. The decoder and filter graph are reset, the output worker
+ *	drops blocks decoded before.
+ *	@param reading is set if the demuxer was repositioned
+ *	@param canRead demuxer can be repositioned
+ *	@return 1 if the position changed, 0 if not, av error code if the
+ *		filter graph could not be rebuilt
+ */
+static int seek (player_t * const player, const int delta,
+		bool * const reading, const bool canRead) {
+	const AVRational tb = player->st->time_base;
+	const double timeBase = av_q2d (tb);
+	BarPlayerRing_t * const out = &player->rings[player->ringW];
+
+	/* relative to what is heard, not decoded */
+	unsigned int rate;
+	const uint64_t heard = positionGet (&player->position, &rate);
+	double target = (rate > 0 ? (double) heard / rate :
+			timeBase * (double) BarPlayerLoad (player->lastTimestamp)) + delta;
+	if (out->duration > 0 && target > out->duration - 1) {
+		target = out->duration - 1;
+	}
+	if (target < 0) {
+		target = 0;
+	}
+	const int64_t ts = (int64_t) (target / timeBase);
+
+	const BarPlayerPacket_t * const first = player->played.head != NULL ?
+			player->played.head : player->queue.head;
+	const BarPlayerPacket_t * const last = player->queue.tail != NULL ?
+			player->queue.tail : player->played.tail;
+	if (first != NULL && first->pkt->pts != AV_NOPTS_VALUE &&
+			last->pkt->pts != AV_NOPTS_VALUE && first->pkt->pts <= ts &&
+			ts < last->pkt->pts + last->pkt->duration) {
+		debugPrint (DEBUG_AUDIO, "seeking to %f s in memory\n", target);
+		queueSplit (player, ts);
+	} else if (canRead) {
+		debugPrint (DEBUG_AUDIO, "seeking to %f s in stream\n", target);
+		const int ret = av_seek_frame (player->fctx, player->streamIdx, ts,
+				AVSEEK_FLAG_BACKWARD);
+		if (ret < 0) {
+			debugPrint (DEBUG_AUDIO, "av_seek_frame failed with code %i\n", ret);
+			return 0;
+		}
+		queueFlush (player);
+		*reading = true;
+	} else {
+		return 0;
+	}
+
+	avcodec_flush_buffers (player->cctx);
+	/* the old graph is kept until the new one works, so the track can be
+	 * ended through it */
+	AVFilterGraph *fgraph = player->fgraph;
+	AVFilterContext * const fabuf = player->fabuf,
+			* const fbufsink = player->fbufsink;
+	if (!openFilter (player)) {
+		avfilter_graph_free (&player->fgraph);
+		player->fgraph = fgraph;
+		player->fabuf = fabuf;
+		player->fbufsink = fbufsink;
+		return AVERROR (EINVAL);
+	}
+	avfilter_graph_free (&fgraph);
+
+	/* the output worker corrects this with the first block played */
+	BarPlayerStore (player->lastTimestamp, ts);
+	BarPlayerStore (player->songPlayed, (unsigned int) target);
+	const uint64_t samples = target * player->output.rate;
+	positionSet (&player->position, true, samples, samples,
+			player->output.rate);
+	BarPlayerStore (out->epoch, out->epoch + 1);
+	return 1;
+}
+
+/*	decode and play stream. returns 0 or av error code.
+ *
+ *	buffer_seconds worth of compressed packets are read ahead into
+ *	player->queue. They are only decoded just in time, the filter graph holds
+ *	at most pcmAhead seconds of PCM.
+ */
+static int play (player_t * const player) {
+	assert (player != NULL);
+	AVCodecContext * const cctx = player->cctx;
+	const double timeBase = av_q2d (player->st->time_base);
+	const double pcmAhead = getPcmAhead (player);
+
+	AVPacket *pkt = av_packet_alloc ();
+	assert (pkt != NULL);
+	pkt->data = NULL;
+	pkt->size = 0;
+
+	AVFrame *frame = NULL, *filteredFrame = NULL;
+	frame = av_frame_alloc ();
+	assert (frame != NULL);
+	filteredFrame = av_frame_alloc ();
+	assert (filteredFrame != NULL);
+	/* reading packets until EOF or error, then draining the queue, the
+	 * decoder and finally the filter graph */
+	bool reading = true, drain = false, done = false, sinkDone = false;
+	int ret = 0, readRet = 0;
+	/* last pts sent to the filter graph */
+	int64_t lastPts = player->lastTimestamp;
+	const unsigned int underruns = BarPlayerLoad (player->underrunsTotal);
+
+	/* arm the fetch thread’s stall watchdog */
+	int64_t byteRate = player->fctx->bit_rate / 8;
+	const double duration = timeBase * (double) player->st->duration;
+	if (byteRate <= 0 && player->fetch->totalSize > 0 && duration > 0) {
+		byteRate = player->fetch->totalSize / duration;
+	}
+	BarPlayerStore (player->fetch->byteRate,
+			byteRate > 0 && byteRate <= UINT_MAX ? (unsigned int) byteRate : 0);
+
+	httpdStart (player);
+
+	/* after switching the quality the old stream’s tail may still be
+	 * playing, it keeps updating the position until this one starts */
+	if (player->resumeAt == 0 ||
+			!BarPlayerLoad (player->rings[!player->ringW].active)) {
+		const uint64_t startSamples = timeBase *
+				(double) player->lastTimestamp * player->output.rate;
+		positionSet (&player->position, true, startSamples, startSamples,
+				player->output.rate);
+	}
+
+	/* hand the ring to the output worker, blocks left over from an aborted
+	 * song are dropped */
+	BarPlayerRing_t * const out = &player->rings[player->ringW];
+	BarRingClear (&out->ring);
+	out->duration = duration > 0 ? duration :
+			BarPlayerLoad (player->songDuration);
+	out->timeBase = timeBase;
+	pthread_mutex_lock (&player->aoplayLock);
+	BarPlayerStore (out->active, true);
+	pthread_cond_broadcast (&player->aoplayCond);
+	pthread_mutex_unlock (&player->aoplayLock);
+
+	while (!shouldQuit (player) && !sinkDone) {
+		const int seekBy = __atomic_exchange_n (&player->seekBy, 0,
+				__ATOMIC_ACQ_REL);
+		const int seekRet = seekBy != 0 && !player->downgrade ?
+				seek (player, seekBy, &reading, readRet == 0) : 0;
+		if (seekRet > 0) {
+			drain = false;
+			done = false;
+			lastPts = player->lastTimestamp;
+		} else if (seekRet < 0) {
+			/* cannot decode any more, play what is decoded and end the
+			 * track */
+			readRet = seekRet;
+			reading = false;
+			queueFlush (player);
+			if (!done) {
+				sendEof (player);
+				done = true;
+			}
+		}
+
+		sinkDone = pullSink (player, filteredFrame);
+		if (sinkDone) {
+			break;
+		}
+		/* only the output worker changes this from now on */
+		const size_t ringUsed = BarRingUsed (&out->ring);
+
+		const double pcmHealth = timeBase *
+				(double) (lastPts - BarPlayerLoad (player->lastTimestamp));
+		const double bufferHealth = pcmHealth +
+				timeBase * (double) player->queue.duration;
+		BarPlayerStore (player->bufferHealth,
+				bufferHealth > 0 ? (unsigned int) bufferHealth : 0);
+		BarPlayerStore (player->fetch->downstreamMs,
+				bufferHealth > 0 ? (unsigned int) (bufferHealth * 1000) : 0);
+
+		if (reading && shouldDowngrade (player, underruns, bufferHealth)) {
+			/* keep playing what is queued already, the new url is opened
+			 * while the output worker plays the rest of the ring and resumes
+			 * after the last queued packet */
+			const BarPlayerPacket_t * const tail = player->queue.tail;
+			const int64_t resumeTs = tail != NULL &&
+					tail->pkt->pts != (int64_t) AV_NOPTS_VALUE ?
+					tail->pkt->pts + tail->pkt->duration : lastPts;
+			player->resumeAt = av_rescale_q (resumeTs, player->st->time_base,
+					AV_TIME_BASE_Q);
+			player->downgrade = true;
+			reading = false;
+			/* free the link for the new url and start connecting */
+			BarFetchStop (player->fetch);
+			prefetchStart (player);
+			continue;
+		}
+
+		/* an empty ring must be refilled even if timestamps are off */
+		if (!done && (pcmHealth <= pcmAhead || ringUsed == 0) &&
+				(player->queue.head != NULL || !reading)) {
+			/* decode just in time */
+			AVPacket * const p = queuePop (player);
+			if (p != NULL) {
+				httpdPacket (player, p);
+				avcodec_send_packet (cctx, p);
+			} else if (!drain) {
+				drain = true;
+				avcodec_send_packet (cctx, NULL);
+				debugPrint (DEBUG_AUDIO, "decoder entering drain mode\n");
+			}
+
+			while (!shouldQuit (player)) {
+				ret = avcodec_receive_frame (cctx, frame);
+				if (ret == AVERROR_EOF) {
+					/* done draining */
+					done = true;
+					debugPrint (DEBUG_AUDIO, "receive_frame got EOF, sending NULL frame\n");
+					sendEof (player);
+					break;
+				} else if (ret != 0) {
+					/* no more output */
+					break;
+				}
+
+				/* XXX: suppresses warning from resample filter */
+				if (frame->pts == (int64_t) AV_NOPTS_VALUE) {
+					frame->pts = 0;
+				} else {
+					lastPts = frame->pts;
+				}
+				ret = av_buffersrc_write_frame (player->fabuf, frame);
+				assert (ret >= 0);
+			}
+		} else if (reading && !queueFull (player) &&
+				(player->queue.head == NULL ||
+				BarFetchReady (player->fetch, 4096))) {
+			/* do not block on the network while there are packets to decode */
+			ret = av_read_frame (player->fctx, pkt);
+			if (ret == AVERROR_EOF) {
+				reading = false;
+				debugPrint (DEBUG_AUDIO, "reader got EOF, %zu bytes queued\n",
+						player->queue.bytes);
+			} else if (ret < 0) {
+				/* error, play what we have and let BarPlayerThread retry */
+				char error[AV_ERROR_MAX_STRING_SIZE];
+				if (av_strerror(ret, error, sizeof(error)) < 0) {
+					strncpy (error, "(unknown)", sizeof(error)-1);
+				}
+				debugPrint (DEBUG_AUDIO, "av_read_frame failed with code %i (%s), "
+						"draining queue\n", ret, error);
+				reading = false;
+				readRet = ret;
+				if (ret == AVERROR_EXIT) {
+					/* interrupted by user, do not play out the buffer */
+					queueFlush (player);
+				}
+			} else if (pkt->stream_index != player->streamIdx) {
+				/* unused packet */
+				av_packet_unref (pkt);
+			} else {
+				queuePush (player, pkt);
+			}
+		} else {
+			/* buffer is healthy, wait until the ao thread consumed some, down
+			 * to ringLow blocks */
+			const size_t low = ringUsed-1 < player->ringLow ?
+					ringUsed-1 : player->ringLow;
+			sleepPrepare (&player->wakeDecoder);
+			const bool sleep = !shouldQuit (player) && ringUsed > 0 &&
+					BarRingUsed (&out->ring) > low &&
+					BarPlayerLoad (player->seekBy) == 0;
+			if (sleep) {
+				debugPrint (DEBUG_AUDIO, "decoding buffer filled health %f s\n",
+						bufferHealth);
+			}
+			/* a second is enough to notice the ring emptying */
+			sleepOn (&player->wakeDecoder, sleep, 1000);
+			if (sleep) {
+				countWakeup (player);
+			}
+		}
+	}
+	queueFlush (player);
+	av_frame_free (&frame);
+	av_frame_free (&filteredFrame);
+	av_packet_free (&pkt);
+	/* with crossfade the next track starts while this one’s tail is still
+	 * playing. Otherwise, and if the track did not end regularly, wait. */
+	if (shouldQuit (player) || (!player->downgrade &&
+			(player->settings->crossfade == 0 || !sinkDone || readRet != 0))) {
+		debugPrint (DEBUG_AUDIO, "decoder is done, waiting for ao player\n");
+		waitOutput (player, false);
+	}
+	/* the output worker stops updating this track’s position */
+	BarPlayerStore (player->ringW, !player->ringW);
+
+	return readRet != 0 ? readRet : ret;
+}
+
+static void finish (player_t * const player) {
+	if (player->fgraph != NULL) {
+		avfilter_graph_free (&player->fgraph);
+		player->fgraph = NULL;
+	}
+	if (player->cctx != NULL) {
+		avcodec_free_context (&player->cctx);
+		player->cctx = NULL;
+	}
+	if (player->fetch != NULL) {
+		const unsigned int throughput = BarPlayerLoad (player->fetch->throughput);
+		if (throughput != 0) {
+			BarPlayerStore (player->throughput, throughput);
+		}
+		/* must not call intCb any more, player is reused for the next song */
+		BarFetchStop (player->fetch);
+	}
+
+	if (player->fctx == NULL && player->fetch == NULL) {
+		return;
+	}
+	BarPlayerReap_t * const r = malloc (sizeof (*r));
+	assert (r != NULL);
+	r->fctx = player->fctx;
+	r->fetch = player->fetch;
+	player->fctx = NULL;
+	player->fetch = NULL;
+
+	pthread_mutex_lock (&reapLock);
+	++reapPending;
+	pthread_mutex_unlock (&reapLock);
+
+	pthread_t thread;
+	if (pthread_create (&thread, NULL, reapThread, r) == 0) {
+		pthread_detach (thread);
+	} else {
+		reapThread (r);
+	}
+}
+
+/*	Reset the decoder’s per-track state. The output worker may still be
+ *	playing the previous track’s tail and resets its own statistics when the
+ *	new track starts.
+ */
+static void resetTrack (player_t * const player) {
+	BarPlayerStore (player->songPlayed, 0);
+	BarPlayerStore (player->bufferHealth, 0);
+	BarPlayerStore (player->lastTimestamp, 0);
+	/* seeks refer to the previous track */
+	BarPlayerStore (player->seekBy, 0);
+	player->streamIdx = -1;
+	player->resumeAt = 0;
+	player->downgrade = false;
+	player->interrupted = 0;
+}
+
+/*	Play one track, with retries
+ *	@return PLAYER_RET_*
+ */
+static int playTrack (player_t * const player, const BarPlayerJob_t * const job) {
+	int pret = PLAYER_RET_OK;
+
+	clock_gettime (CLOCK_MONOTONIC, &player->startTime);
+	resetTrack (player);
+	player->url = job->url;
+	player->gain = job->gain;
+	player->format = job->format;
+	player->urls = job->urls;
+	player->quality = job->quality;
+
+	bool retry;
+	do {
+		retry = false;
+		if (openStream (player)) {
+			if (openFilter (player) && openRing (player) &&
+					openDevice (player)) {
+				changeMode (player, PLAYER_PLAYING);
+				BarPlayerSetVolume (player);
+				const int ret = play (player);
+				retry = ((ret == AVERROR_INVALIDDATA ||
+						 ret == -ECONNRESET) &&
+						!player->interrupted) ||
+						(player->downgrade && !shouldQuit (player));
+				if (player->downgrade) {
+					/* play() set resumeAt */
+					player->url = player->urls[player->quality].url;
+					player->format = player->urls[player->quality].format;
+					player->downgrade = false;
+				} else {
+					player->resumeAt = av_rescale_q (player->lastTimestamp,
+							player->st->time_base, AV_TIME_BASE_Q);
+				}
 			} else {
 				/* filter missing or audio device busy */
 				pret = PLAYER_RET_HARDFAIL;
@@ -554,76 +1702,546 @@ void *BarPlayerThread (void *data) {
 		changeMode (player, PLAYER_WAITING);
 		finish (player);
 	} while (retry);
+	prefetchCancel (player);
+
+	return pret;
+}
+
+/*	Wait for the next job. The audio device is closed if no job arrives
+ *	for a while, so other applications can use it.
+ *	@return false if the player is terminating
+ */
+static bool nextJob (player_t * const player, BarPlayerJob_t * const job) {
+	static const int idleSecs = 5;
+
+	pthread_mutex_lock (&player->lock);
+	while (player->jobCount == 0 && !player->terminate) {
+		if (!BarOutputIsOpen (&player->output)) {
+			pthread_cond_wait (&player->jobCond, &player->lock);
+			continue;
+		}
+
+		struct timespec deadline;
+		clock_gettime (CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += idleSecs;
+		if (pthread_cond_timedwait (&player->jobCond, &player->lock,
+				&deadline) == ETIMEDOUT && player->jobCount == 0 &&
+				!BarPlayerLoad (player->rings[0].active) &&
+				!BarPlayerLoad (player->rings[1].active)) {
+			/* the output worker is idle and the device is ours, closing
+			 * may block while draining */
+			pthread_mutex_unlock (&player->lock);
+			debugPrint (DEBUG_AUDIO, "closing idle audio device\n");
+			BarOutputClose (&player->output);
+			pthread_mutex_lock (&player->lock);
+		}
+	}
+	const bool haveJob = !player->terminate;
+	if (haveJob) {
+		*job = player->jobs[player->jobStart];
+		player->jobStart = (player->jobStart + 1) % BAR_PLAYER_MAXJOBS;
+		--player->jobCount;
+		/* skipping applies to the previous track */
+		BarPlayerStore (player->doQuit, false);
+	}
+	pthread_mutex_unlock (&player->lock);
 
-	changeMode (player, PLAYER_FINISHED);
+	return haveJob;
+}
 
-	return (void *) pret;
+/*	Seek the current track relative to its position. Requests add up until
+ *	the decoder picks them up.
+ */
+void BarPlayerSeek (player_t * const player, const int seconds) {
+	__atomic_add_fetch (&player->seekBy, seconds, __ATOMIC_ACQ_REL);
+	wakeUp (&player->wakeDecoder);
 }
 
-void *BarAoPlayThread (void *data) {
+/*	Queue track for playback. Mode must be set to PLAYER_WAITING before.
+ *	@return false if the queue is full
+ */
+bool BarPlayerSubmit (player_t * const player, const BarPlayerJob_t * const job) {
+	assert (player != NULL);
+	assert (job != NULL);
+
+	pthread_mutex_lock (&player->lock);
+	const bool ok = player->jobCount < BAR_PLAYER_MAXJOBS;
+	if (ok) {
+		player->jobs[(player->jobStart + player->jobCount) % BAR_PLAYER_MAXJOBS] =
+				*job;
+		++player->jobCount;
+		pthread_cond_broadcast (&player->jobCond);
+	}
+	pthread_mutex_unlock (&player->lock);
+
+	return ok;
+}
+
+/*	decoder worker, plays jobs submitted by BarPlayerSubmit until
+ *	BarPlayerDestroy
+ */
+void *BarPlayerThread (void *data) {
 	assert (data != NULL);
 
 	player_t * const player = data;
+	BarPlayerJob_t job;
 
-	AVFrame *filteredFrame = NULL;
-	filteredFrame = av_frame_alloc ();
-	assert (filteredFrame != NULL);
+	while (nextJob (player, &job)) {
+		const int pret = playTrack (player, &job);
+		BarPlayerStore (player->result, pret);
+		changeMode (player, PLAYER_FINISHED);
+	}
+
+	return NULL;
+}
+
+/* output worker state */
+typedef struct {
+	/* ring played, the other one is mixed in during crossfade */
+	unsigned int cur;
+	/* samples of each ring’s first block that were played already */
+	size_t offset[2];
+	/* first sample of the ring’s track was played */
+	bool started[2];
+	bool starving;
+	struct timespec starveStart;
+	/* time and duration of the last write, for jitter */
+	bool lastValid;
+	struct timespec last;
+	double lastSecs;
+} BarAoState_t;
+
+/*	Output worker is done with ring i, wake up the decoder if it waits for it
+ */
+static void aoRelease (player_t * const player, BarAoState_t * const s,
+		const unsigned int i) {
+	pthread_mutex_lock (&player->aoplayLock);
+	BarPlayerStore (player->rings[i].active, false);
+	pthread_cond_broadcast (&player->aoplayCond);
+	pthread_mutex_unlock (&player->aoplayLock);
+	s->offset[i] = 0;
+	s->started[i] = false;
+}
+
+/*	Get planes of block b, starting at sample offset
+ *	@return samples left in b
+ */
+static size_t aoPlanes (const BarRingBlock_t * const b, const size_t channels,
+		const size_t offset, const float ** const planes) {
+	const size_t samples = b->len / (channels * sizeof (float));
+	for (size_t c = 0; c < channels; c++) {
+		planes[c] = (const float *) &b->data[c * samples * sizeof (float)] +
+				offset;
+	}
+	return samples - offset;
+}
+
+/*	Next block of ring i, blocks decoded before the last seek are dropped
+ */
+static BarRingBlock_t *aoReadable (player_t * const player,
+		BarAoState_t * const s, const unsigned int i) {
+	BarPlayerRing_t * const r = &player->rings[i];
+	BarRingBlock_t *b;
+	while ((b = BarRingReadable (&r->ring)) != NULL &&
+			b->epoch != BarPlayerLoad (r->epoch)) {
+		BarRingPop (&r->ring);
+		s->offset[i] = 0;
+		wakeUp (&player->wakeDecoder);
+	}
+	return b;
+}
+
+/*	Ring is empty, wait for the decoder
+ */
+static void aoStarve (player_t * const player, BarAoState_t * const s) {
+	const unsigned int cur = s->cur;
+
+	sleepPrepare (&player->wakeOutput);
+	const bool sleep = BarRingReadable (&player->rings[cur].ring) == NULL &&
+			!shouldQuit (player);
+	if (sleep) {
+		debugPrint (DEBUG_AUDIO, "ao player is waiting for more blocks\n");
+		if (s->started[cur] && !s->starving &&
+				cur == BarPlayerLoad (player->ringW)) {
+			/* buffer ran dry during playback */
+			s->starving = true;
+			clock_gettime (CLOCK_MONOTONIC, &s->starveStart);
+			BarPlayerStore (player->underruns,
+					BarPlayerLoad (player->underruns) + 1);
+			BarPlayerStore (player->underrunsTotal,
+					BarPlayerLoad (player->underrunsTotal) + 1);
+			BarPlayerStore (player->underrunPos,
+					BarPlayerLoad (player->songPlayed));
+			bufferUnderrun (player);
+		}
+	}
+	sleepOn (&player->wakeOutput, sleep, 100);
+	if (sleep) {
+		countWakeup (player);
+	}
+	s->lastValid = false;
+}
+
+/*	Update position of ring i’s track, if it is the decoder’s current one
+ *	@param block played
+ *	@param sample offset within block, after the samples written
+ *	@param latency of the device in seconds
+ */
+static void aoPlayed (player_t * const player, BarAoState_t * const s,
+		const unsigned int i, const BarRingBlock_t * const b,
+		const size_t offset, const double latency) {
+	const unsigned int rate = player->output.rate;
+	const double timestamp = b->timestamp + (double) offset / rate;
+	const double heard = timestamp > latency ? timestamp - latency : 0;
+
+	if (!s->started[i]) {
+		struct timespec now;
+		clock_gettime (CLOCK_MONOTONIC, &now);
+		debugPrint (DEBUG_AUDIO, "time to first sample %lld ms\n",
+				(now.tv_sec - player->startTime.tv_sec) * 1000LL +
+				(now.tv_nsec - player->startTime.tv_nsec) / 1000000);
+		s->started[i] = true;
+		if (i == BarPlayerLoad (player->ringW)) {
+			/* statistics of the new track, the decoder only looks at
+			 * underrunsTotal */
+			BarPlayerStore (player->underruns, 0);
+			BarPlayerStore (player->underrunMs, 0);
+			BarPlayerStore (player->underrunPos, 0);
+			BarPlayerStore (player->jitterUs, 0);
+			BarPlayerStore (player->wakeups, 0);
+		}
+	}
+
+	if (i != BarPlayerLoad (player->ringW) ||
+			b->epoch != BarPlayerLoad (player->rings[i].epoch)) {
+		/* tail of the previous track, or seeking */
+		return;
+	}
+	BarPlayerStore (player->songPlayed, (unsigned int) heard);
+	positionSet (&player->position, false, timestamp * rate, heard * rate,
+			rate);
+	bufferStable (player, s->lastSecs);
+	/* lastTimestamp must be the last pts, but expressed in terms of
+	 * st->time_base, not the sink’s time_base. */
+	BarPlayerStore (player->lastTimestamp,
+			(int64_t) (timestamp / player->rings[i].timeBase));
+}
+
+/*	n samples of ring i’s block b were played
+ */
+static void aoConsume (player_t * const player, BarAoState_t * const s,
+		const unsigned int i, const BarRingBlock_t * const b, const size_t n) {
+	BarRing_t * const ring = &player->rings[i].ring;
+
+	s->offset[i] += n;
+	if (s->offset[i] * player->output.channels * sizeof (float) >= b->len) {
+		s->offset[i] = 0;
+		BarRingPop (ring);
+		/* notify decoder, we might need more data */
+		if (i == BarPlayerLoad (player->ringW) &&
+				BarRingUsed (ring) <= player->ringLow) {
+			wakeUp (&player->wakeDecoder);
+		}
+	}
+}
+
+/*	Write one block to the device. Waiting for a slow device can be
+ *	interrupted by skipping, and the decoder keeps filling the ring in the
+ *	meantime. If the device went away the block is dropped in real time.
+ */
+static void outputPlay (player_t * const player, const uint8_t *buf,
+		size_t len, const double secs) {
+	while (len > 0) {
+		const ssize_t ret = BarOutputWrite (&player->output, buf, len);
+		if (ret < 0) {
+			/* openDevice reopens it with the next track */
+			sleepOn (&player->wakeOutput, true, secs * 1000);
+			return;
+		}
+		buf += ret;
+		len -= ret;
+		if (len > 0 && shouldQuit (player)) {
+			return;
+		}
+	}
+}
+
+/*	Play one block or less of the current ring. During the last crossfade
+ *	seconds of a track the next ring is mixed in with equal power. Runs
+ *	with real-time priority if enabled, so nothing in here must allocate
+ *	or lock.
+ */
+static void aoStep (player_t * const player, BarAoState_t * const s) {
+	static const double halfPi = 1.5707963267948966;
+	const unsigned int cur = s->cur, next = !cur;
+	BarPlayerRing_t * const a = &player->rings[cur],
+			* const b = &player->rings[next];
+	const size_t channels = player->output.channels;
+	const double rate = player->output.rate;
+	const unsigned int fade = player->settings->crossfade;
+
+	BarRingBlock_t * const blockA = aoReadable (player, s, cur);
+	if (blockA == NULL) {
+		aoStarve (player, s);
+		return;
+	} else if (blockA->eof) {
+		BarRingPop (&a->ring);
+		debugPrint (DEBUG_AUDIO, "ao player got EOF\n");
+		aoRelease (player, s, cur);
+		s->cur = next;
+		return;
+	}
+
+	if (s->starving) {
+		struct timespec now;
+		clock_gettime (CLOCK_MONOTONIC, &now);
+		const unsigned int ms = (now.tv_sec - s->starveStart.tv_sec) * 1000LL +
+				(now.tv_nsec - s->starveStart.tv_nsec) / 1000000;
+		BarPlayerStore (player->underrunMs,
+				BarPlayerLoad (player->underrunMs) + ms);
+		debugPrint (DEBUG_AUDIO, "underrun lasted %u ms\n", ms);
+		s->starving = false;
+	}
+
+	const float *planesA[BAR_MIX_MAXCHANNELS], *planesB[BAR_MIX_MAXCHANNELS];
+	size_t n = aoPlanes (blockA, channels, s->offset[cur], planesA);
+
+	/* fade position, 0 is the start of the crossfade */
+	double x0 = 1;
+	bool fading = false;
+	BarRingBlock_t *blockB = NULL;
+	if (fade > 0 && a->duration > 0 && BarPlayerLoad (b->active)) {
+		const double remaining = a->duration -
+				(blockA->timestamp + s->offset[cur] / rate);
+		if (remaining < fade) {
+			fading = true;
+			x0 = remaining > 0 ? 1 - remaining / fade : 1;
+			blockB = aoReadable (player, s, next);
+			if (blockB != NULL && blockB->eof) {
+				blockB = NULL;
+			}
+			if (blockB != NULL) {
+				const size_t nb = aoPlanes (blockB, channels, s->offset[next],
+						planesB);
+				n = nb < n ? nb : n;
+			} else {
+				/* next track is late, fade out anyway */
+				memcpy (planesB, planesA, sizeof (planesB));
+			}
+		}
+	}
+
+	float volume, gainA, gainB;
+	__atomic_load (&player->volume, &volume, __ATOMIC_ACQUIRE);
+	__atomic_load (&a->gain, &gainA, __ATOMIC_ACQUIRE);
+	__atomic_load (&b->gain, &gainB, __ATOMIC_ACQUIRE);
+	const float *planesMix[BAR_MIX_MAXCHANNELS];
+	const float * const *planes = planesA;
+	float gain = volume * gainA;
+	if (fading) {
+		double x1 = x0 + n / rate / fade;
+		x1 = x1 > 1 ? 1 : x1;
+		const float ga0 = gainA * cos (x0 * halfPi), ga1 = gainA * cos (x1 * halfPi),
+				gb0 = blockB != NULL ? gainB * sin (x0 * halfPi) : 0,
+				gb1 = blockB != NULL ? gainB * sin (x1 * halfPi) : 0;
+		for (size_t c = 0; c < channels; c++) {
+			float * const dst = &player->mixBuf[c * n];
+			BarMixFade (dst, planesA[c], planesB[c], n, ga0, ga1, gb0, gb1);
+			planesMix[c] = dst;
+		}
+		planes = planesMix;
+		gain = volume;
+	}
+	/* convert planar float to the device format, with volume */
+	const bool dither = player->settings->audioDither;
+	BarMixConvert (&player->mix, player->aoBuf, player->output.format, planes,
+			channels, n, gain, dither);
+	const size_t len = n * channels * BarMixSampleSize (player->output.format);
+
+	/* before the device blocks */
+	if (player->sinks.count > 0) {
+		const BarMixFormat_t sinkFmt = player->settings->audioPipeFormat;
+		if (sinkFmt == player->output.format) {
+			BarSinksFeed (&player->sinks, player->aoBuf, len);
+		} else {
+			BarMixConvert (&player->mix, player->sinkBuf, sinkFmt, planes,
+					channels, n, gain, dither);
+			BarSinksFeed (&player->sinks, player->sinkBuf,
+					n * channels * BarMixSampleSize (sinkFmt));
+		}
+	}
+
+	outputPlay (player, player->aoBuf, len, n / rate);
+	countWakeup (player);
+
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	if (s->lastValid) {
+		/* writing blocks until the device consumed the previous block,
+		 * anything beyond its duration is scheduling delay */
+		const long long lateUs = (now.tv_sec - s->last.tv_sec) * 1000000LL +
+				(now.tv_nsec - s->last.tv_nsec) / 1000 -
+				(long long) (s->lastSecs * 1000000);
+		if (lateUs > BarPlayerLoad (player->jitterUs)) {
+			BarPlayerStore (player->jitterUs, lateUs > UINT_MAX ? UINT_MAX :
+					(unsigned int) lateUs);
+		}
+	}
+	s->last = now;
+	s->lastSecs = n / rate;
+	s->lastValid = true;
+
+	const double latency = BarOutputLatency (&player->output);
+	aoPlayed (player, s, cur, blockA, s->offset[cur] + n, latency);
+	aoConsume (player, s, cur, blockA, n);
+	if (blockB != NULL) {
+		aoPlayed (player, s, next, blockB, s->offset[next] + n, latency);
+		aoConsume (player, s, next, blockB, n);
+	}
+}
 
+/*	Reopen the device after pausing, with the same format. Retries until it
+ *	succeeds or the song is skipped.
+ */
+static void reacquireDevice (player_t * const player) {
+	bool failed = false;
+
+	while (!shouldQuit (player) && !BarOutputReacquire (&player->output)) {
+		if (!failed) {
+			BarUiMsg (player->settings, MSG_ERR, "Cannot reopen audio device, "
+					"retrying.\n");
+			failed = true;
+		}
+		sleepOn (&player->wakeOutput, true, 1000);
+	}
+}
+
+/*	Switch the calling thread to real-time priority and pin it, if
+ *	audio_realtime is enabled
+ */
+static void setRealtime (player_t * const player) {
+	const BarSettings_t * const settings = player->settings;
+
+	if (!settings->audioRealtime) {
+		return;
+	}
+
+	struct sched_param param;
+	memset (&param, 0, sizeof (param));
+	/* leave room above us for more important things, like the sound
+	 * server’s own threads */
+	param.sched_priority = (sched_get_priority_min (SCHED_FIFO) +
+			sched_get_priority_max (SCHED_FIFO)) / 2;
 	int ret;
-	const double timeBase = av_q2d (av_buffersink_get_time_base (player->fbufsink)),
-			timeBaseSt = av_q2d (player->st->time_base);
-	while (!shouldQuit(player)) {
-		pthread_mutex_lock (&player->aoplayLock);
-		ret = av_buffersink_get_frame (player->fbufsink, filteredFrame);
-		if (ret == AVERROR_EOF || shouldQuit (player)) {
-			/* we are done here */
-			pthread_mutex_unlock (&player->aoplayLock);
-			debugPrint (DEBUG_AUDIO, "ao player got EOF, exiting\n");
-			break;
-		} else if (ret < 0) {
-			/* wait for more frames */
-			debugPrint (DEBUG_AUDIO, "ao player is waiting for more frames after code %i (%s)\n",
-					ret, av_err2str (ret));
-			pthread_cond_broadcast (&player->aoplayCond);
-			pthread_cond_wait (&player->aoplayCond, &player->aoplayLock);
+	if ((ret = pthread_setschedparam (pthread_self (), SCHED_FIFO,
+			&param)) != 0) {
+		BarUiMsg (settings, MSG_ERR, "Cannot use real-time priority for "
+				"audio output (%s).\n", strerror (ret));
+	}
+
+#ifdef __linux__
+	long cpu = settings->audioCpu;
+	if (cpu < 0) {
+		cpu = sysconf (_SC_NPROCESSORS_ONLN) - 1;
+	}
+	if (cpu >= 0 && cpu < CPU_SETSIZE) {
+		cpu_set_t set;
+		CPU_ZERO (&set);
+		CPU_SET (cpu, &set);
+		if ((ret = pthread_setaffinity_np (pthread_self (), sizeof (set),
+				&set)) != 0) {
+			BarUiMsg (settings, MSG_ERR, "Cannot pin audio output to cpu %ld "
+					"(%s).\n", cpu, strerror (ret));
+		}
+	}
+#endif
+
+	/* what is in effect, buffers report whether they are locked */
+	int policy;
+	if (pthread_getschedparam (pthread_self (), &policy, &param) == 0) {
+		debugPrint (DEBUG_AUDIO, "output worker runs with %s priority %i\n",
+				policy == SCHED_FIFO ? "SCHED_FIFO" : "normal",
+				param.sched_priority);
+	}
+}
+
+/*	output worker, plays the rings play() hands over
+ */
+void *BarAoPlayThread (void *data) {
+	assert (data != NULL);
+
+	player_t * const player = data;
+	BarPlayerRing_t * const rings = player->rings;
+	BarAoState_t s;
+	memset (&s, 0, sizeof (s));
+
+	setRealtime (player);
+
+	while (true) {
+		if (!BarPlayerLoad (rings[s.cur].active)) {
+			if (BarPlayerLoad (rings[!s.cur].active)) {
+				s.cur = !s.cur;
+				continue;
+			}
+
+			/* idle */
+			pthread_mutex_lock (&player->aoplayLock);
+			while (!rings[0].active && !rings[1].active &&
+					!BarPlayerLoad (player->terminate)) {
+				pthread_cond_wait (&player->aoplayCond, &player->aoplayLock);
+			}
+			const bool idle = !rings[0].active && !rings[1].active;
 			pthread_mutex_unlock (&player->aoplayLock);
+			if (idle) {
+				/* terminating */
+				break;
+			}
+			s.lastValid = false;
+			s.starving = false;
 			continue;
 		}
-		pthread_mutex_unlock (&player->aoplayLock);
-
-		const int numChannels = filteredFrame->ch_layout.nb_channels;
-		const int bps = av_get_bytes_per_sample (filteredFrame->format);
-		ao_play (player->aoDev, (char *) filteredFrame->data[0],
-				filteredFrame->nb_samples * numChannels * bps);
 
-		const double timestamp = (double) filteredFrame->pts * timeBase;
-		const unsigned int songPlayed = timestamp;
+		if (shouldQuit (player)) {
+			/* skipping drops a fading track as well */
+			for (unsigned int i = 0; i < 2; i++) {
+				if (BarPlayerLoad (rings[i].active)) {
+					aoRelease (player, &s, i);
+				}
+			}
+			debugPrint (DEBUG_AUDIO, "ao player dropped its buffers\n");
+			continue;
+		}
 
-		pthread_mutex_lock (&player->lock);
-		player->songPlayed = songPlayed;
-		/* pausing */
-		if (player->doPause) {
-			do {
+		aoStep (player, &s);
+
+		/* pausing, the lock is only taken if we actually have to wait */
+		if (BarPlayerLoad (player->doPause)) {
+			const bool release = player->settings->audioPauseRelease;
+			bool paused = false;
+			if (release) {
+				BarOutputRelease (&player->output);
+			} else if ((paused = BarOutputPause (&player->output, true))) {
+				/* buffered samples are kept, so the position stops */
+				unsigned int rate;
+				const uint64_t heard = positionGet (&player->position, &rate);
+				positionSet (&player->position, false, heard, heard, rate);
+			}
+			pthread_mutex_lock (&player->lock);
+			while (player->doPause) {
 				debugPrint (DEBUG_AUDIO, "ao player is paused\n");
 				pthread_cond_wait (&player->cond, &player->lock);
-			} while (player->doPause);
+			}
+			pthread_mutex_unlock (&player->lock);
+			if (release) {
+				reacquireDevice (player);
+			} else if (paused) {
+				BarOutputPause (&player->output, false);
+			}
 			debugPrint (DEBUG_AUDIO, "ao player continues\n");
+			s.lastValid = false;
 		}
-		pthread_mutex_unlock (&player->lock);
-
-		/* lastTimestamp must be the last pts, but expressed in terms of
-		 * st->time_base, not the sink’s time_base. */
-		const int64_t lastTimestamp = timestamp/timeBaseSt;
-		/* notify download thread, we might need more data */
-		pthread_mutex_lock (&player->aoplayLock);
-		player->lastTimestamp = lastTimestamp;
-		pthread_cond_broadcast (&player->aoplayCond);
-		pthread_mutex_unlock (&player->aoplayLock);
-
-		av_frame_unref (filteredFrame);
 	}
-	av_frame_free (&filteredFrame);
-	debugPrint (DEBUG_AUDIO, "ao player is done\n");
 
-	return (void *) 0;
+	return NULL;
 }
+
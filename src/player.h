@@ -30,14 +30,20 @@ THE SOFTWARE.
 #include <pthread.h>
 #include <stdint.h>
 #include <signal.h>
+#include <time.h>
 
-#include <ao/ao.h>
 #include <libavformat/avformat.h>
 #include <libavfilter/avfilter.h>
 #include <libavcodec/avcodec.h>
 #include <piano.h>
 
 #include "settings.h"
+#include "fetch.h"
+#include "ring.h"
+#include "mix.h"
+#include "output.h"
+#include "sink.h"
+#include "httpd.h"
 
 typedef enum {
 	/* not running */
@@ -50,8 +56,74 @@ typedef enum {
 	PLAYER_FINISHED,
 } BarPlayerMode;
 
+/* lock-free access to the public player state below, use these for every
+ * access while the player thread is running */
+#define BarPlayerLoad(var) __atomic_load_n (&(var), __ATOMIC_ACQUIRE)
+#define BarPlayerStore(var, val) __atomic_store_n (&(var), (val), __ATOMIC_RELEASE)
+
+/* compressed read-ahead, owned by the decoder thread */
+typedef struct BarPlayerPacket {
+	AVPacket *pkt;
+	struct BarPlayerPacket *next;
+} BarPlayerPacket_t;
+
+typedef struct {
+	BarPlayerPacket_t *head, *tail;
+	/* in stream time base */
+	int64_t duration;
+	size_t bytes;
+} BarPlayerQueue_t;
+
+/* a track to play, see BarPlayerSubmit */
+typedef struct {
+	char *url;
+	double gain;
+	/* enables fast open if known */
+	PianoAudioFormat_t format;
+	/* alternative qualities for adaptive streaming, NULL if disabled */
+	const PianoAudioUrl_t *urls;
+	PianoAudioQuality_t quality;
+} BarPlayerJob_t;
+
+#define BAR_PLAYER_MAXJOBS 4
+
+/* filtered audio of one track, from decoder to output worker */
+typedef struct {
+	BarRing_t ring;
+	/* linear track gain (file gain), see BarPlayerSetVolume */
+	float gain;
+	/* track length in seconds, 0 if unknown, and stream time base */
+	double duration, timeBase;
+	/* filled by the decoder or not played yet. Written with aoplayLock
+	 * held, read with BarPlayerLoad. */
+	bool active;
+	/* incremented by the decoder when seeking, the output worker drops
+	 * blocks of previous epochs */
+	unsigned int epoch;
+} BarPlayerRing_t;
+
+/* position of the current track as heard, a seqlock written by the output
+ * worker and, when seeking, the decoder. See BarPlayerGetPositionMs. */
 typedef struct {
-	/* public attributes protected by mutex */
+	/* odd while being written */
+	unsigned int seq;
+	/* samples at rate written to the device, and heard, which is written
+	 * minus the device’s latency */
+	uint64_t written, heard;
+	unsigned int rate;
+	/* CLOCK_MONOTONIC of the update in microseconds */
+	int64_t at;
+} BarPlayerPosition_t;
+
+/* self-pipe a worker sleeps on, written only if waiting is set */
+typedef struct {
+	int fd[2];
+	bool waiting;
+} BarPlayerWake_t;
+
+typedef struct {
+	/* public attributes, accessed with BarPlayerLoad/Store. lock and cond are
+	 * only required to wait for or broadcast changes to doPause */
 	pthread_mutex_t lock, aoplayLock;
 	pthread_cond_t cond, aoplayCond; /* broadcast changes to doPause */
 	bool doQuit, doPause;
@@ -59,13 +131,41 @@ typedef struct {
 	/* measured in seconds */
 	unsigned int songDuration;
 	unsigned int songPlayed;
+	unsigned int bufferHealth;
+	/* buffer underruns of the current song: count, total duration in
+	 * milliseconds and song position of the last one in seconds */
+	unsigned int underruns, underrunMs, underrunPos;
+	/* underruns since startup, never reset */
+	unsigned int underrunsTotal;
+	/* effective buffer size in seconds, adapted to underruns. 0 until the
+	 * first song is played. Kept across songs. */
+	unsigned int bufferTarget;
+	/* download rate in kbit/s, 0 if unknown. Kept across songs. */
+	unsigned int throughput;
+	/* worst-case wake-up delay of the output thread during the current
+	 * song in microseconds */
+	unsigned int jitterUs;
+	/* times the decoder and output worker woke up during the current song */
+	unsigned int wakeups;
+	/* pending relative seek in seconds, see BarPlayerSeek */
+	int seekBy;
+	/* songPlayed is updated once per block and rounded down, this is more
+	 * precise */
+	BarPlayerPosition_t position;
 
 	BarPlayerMode mode;
+	/* PLAYER_RET_* of the last track, valid in PLAYER_FINISHED */
+	int result;
+
+	/* readable end is signalled whenever mode changes */
+	int notifyFd[2];
+
+	/* receives the current track, set before the first one is played */
+	BarHttpd_t *httpd;
 
 	/* private attributes _not_ protected by mutex */
 
 	/* libav */
-	AVFilterContext *fvolume;
 	AVFilterGraph *fgraph;
 	AVFormatContext *fctx;
 	AVStream *st;
@@ -73,13 +173,69 @@ typedef struct {
 	AVFilterContext *fbufsink, *fabuf;
 	int streamIdx;
 	int64_t lastTimestamp;
+	/* resume position after retry, in AV_TIME_BASE */
+	int64_t resumeAt;
+	/* set by play() to switch to a lower quality */
+	bool downgrade;
+	/* seconds played since the last underrun or buffer change */
+	double stableSecs;
 	sig_atomic_t interrupted;
+	/* packets not decoded yet, and decoded ones kept for seeking back */
+	BarPlayerQueue_t queue, played;
+	BarFetch_t *fetch;
+	/* lower quality’s url, connected in the background after downgrading
+	 * while the queued packets play out */
+	BarFetch_t *prefetch;
+	pthread_t prefetchThread;
+	bool prefetching;
+	int prefetchRet;
 
-	ao_device *aoDev;
+	/* kept open across tracks with the same format */
+	BarOutput_t output;
+	/* output worker’s conversion to the device format and crossfade scratch
+	 * space, one block each */
+	BarMix_t mix;
+	uint8_t *aoBuf;
+	float *mixBuf;
+	size_t aoBufSize, mixBufSize;
+	/* audio_sinks, opened with the first track. They get audio_pipe_format,
+	 * converted to sinkBuf if the device’s format is different. */
+	BarSinks_t sinks;
+	bool sinksOpened;
+	uint8_t *sinkBuf;
+	size_t sinkBufSize;
+	/* ADTS header for httpd, without frame length, if the track is AAC */
+	uint8_t adts[7];
+	bool adtsValid;
+	/* linear master gain, set by BarPlayerSetVolume */
+	float volume;
 
-	/* settings (must be set before starting the thread) */
+	/* used to measure time to first sample */
+	struct timespec startTime;
+
+	/* workers, started by BarPlayerInit. Jobs are protected by lock. */
+	pthread_t decoderThread, aoThread;
+	pthread_cond_t jobCond;
+	BarPlayerJob_t jobs[BAR_PLAYER_MAXJOBS];
+	size_t jobStart, jobCount;
+	bool terminate;
+	/* the decoder fills rings[ringW], alternating between tracks, so the
+	 * next track can be mixed into the previous one’s tail. The decoder is
+	 * woken up once no more than ringLow blocks are left. */
+	BarPlayerRing_t rings[2];
+	unsigned int ringW;
+	size_t ringLow;
+	/* decoder waits for free blocks, output worker for new ones */
+	BarPlayerWake_t wakeDecoder, wakeOutput;
+
+	/* current track, copied from its job */
 	double gain;
 	char *url;
+	PianoAudioFormat_t format;
+	const PianoAudioUrl_t *urls;
+	PianoAudioQuality_t quality;
+
+	/* settings (must be set before starting the thread) */
 	const BarSettings_t *settings;
 } player_t;
 
@@ -89,7 +245,13 @@ void *BarPlayerThread (void *data);
 void *BarAoPlayThread (void *data);
 void BarPlayerSetVolume (player_t * const player);
 void BarPlayerInit (player_t * const p, const BarSettings_t * const settings);
-void BarPlayerReset (player_t * const p);
 void BarPlayerDestroy (player_t * const p);
 BarPlayerMode BarPlayerGetMode (player_t * const player);
+void BarPlayerClearNotify (player_t * const player);
+void BarPlayerWakeup (player_t * const player);
+void BarPlayerSelectAudio (player_t * const player, BarPlayerJob_t * const job,
+		const PianoSong_t * const song);
+bool BarPlayerSubmit (player_t * const player, const BarPlayerJob_t * const job);
+void BarPlayerSeek (player_t * const player, const int seconds);
+unsigned int BarPlayerGetPositionMs (const player_t * const player);
 
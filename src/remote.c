@@ -0,0 +1,724 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* control and query pianobar through a unix domain socket.
+ *
+ * Every line sent by a client is one command, either plain text
+ * ("status", "key n", "act_songnext") or a json object
+ * ({"cmd": "key", "arg": "n"}). Each command is answered by exactly one line
+ * containing a json object, in order. Clients may send any number of commands
+ * at once.
+ *
+ * After "subscribe" a client receives events (same as eventcmd), changes of
+ * player mode, pause state, volume and buffer health, as well as position
+ * updates at the requested interval. All of them are json lines with an
+ * "event" key and contain only what changed.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <json.h>
+
+#include "remote.h"
+#include "main.h"
+#include "debug.h"
+#include "ui.h"
+#include "ui_dispatch.h"
+
+void BarRemoteInit (BarRemote_t * const remote) {
+	memset (remote, 0, sizeof (*remote));
+	remote->fd = -1;
+	for (size_t i = 0; i < BAR_REMOTE_MAXCLIENTS; i++) {
+		remote->clients[i].fd = -1;
+	}
+}
+
+/*	Set O_NONBLOCK and FD_CLOEXEC, the main loop must never block on clients
+ *	and eventcmd must not inherit them.
+ */
+static void BarRemoteSetFlags (const int fd) {
+	fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+	fcntl (fd, F_SETFD, FD_CLOEXEC);
+}
+
+/*	Start listening at path, removes stale sockets
+ */
+bool BarRemoteOpen (BarRemote_t * const remote, const char * const path) {
+	assert (remote != NULL);
+	assert (path != NULL);
+
+	struct sockaddr_un addr;
+	memset (&addr, 0, sizeof (addr));
+	if (strlen (path) >= sizeof (addr.sun_path)) {
+		return false;
+	}
+	addr.sun_family = AF_UNIX;
+	strcpy (addr.sun_path, path);
+
+	/* previous instance did not clean up, but never remove anything else */
+	struct stat st;
+	if (stat (path, &st) == 0 && S_ISSOCK (st.st_mode)) {
+		unlink (path);
+	}
+
+	if ((remote->fd = socket (AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		return false;
+	}
+	if (bind (remote->fd, (struct sockaddr *) &addr, sizeof (addr)) == -1 ||
+			listen (remote->fd, BAR_REMOTE_MAXCLIENTS) == -1) {
+		close (remote->fd);
+		remote->fd = -1;
+		return false;
+	}
+	BarRemoteSetFlags (remote->fd);
+	remote->path = strdup (path);
+
+	return true;
+}
+
+static void BarRemoteClientClose (BarRemoteClient_t * const client) {
+	debugPrint (DEBUG_UI, "remote: closing client %i\n", client->fd);
+	close (client->fd);
+	client->fd = -1;
+	client->bufLen = 0;
+	free (client->out);
+	client->out = NULL;
+	client->outLen = client->outSize = 0;
+	client->subscribed = false;
+}
+
+void BarRemoteDestroy (BarRemote_t * const remote) {
+	for (size_t i = 0; i < BAR_REMOTE_MAXCLIENTS; i++) {
+		if (remote->clients[i].fd != -1) {
+			BarRemoteClientClose (&remote->clients[i]);
+		}
+	}
+	if (remote->fd != -1) {
+		close (remote->fd);
+		remote->fd = -1;
+	}
+	if (remote->path != NULL) {
+		unlink (remote->path);
+		free (remote->path);
+		remote->path = NULL;
+	}
+}
+
+/*	Add listening socket and clients to poll set
+ *	@param remote
+ *	@param array with at least BAR_REMOTE_MAXFDS elements
+ *	@return number of fds added
+ */
+size_t BarRemotePollFds (const BarRemote_t * const remote,
+		struct pollfd * const fds) {
+	size_t n = 0;
+
+	if (remote->fd == -1) {
+		return 0;
+	}
+
+	fds[n].fd = remote->fd;
+	fds[n].events = POLLIN;
+	++n;
+	for (size_t i = 0; i < BAR_REMOTE_MAXCLIENTS; i++) {
+		if (remote->clients[i].fd != -1) {
+			fds[n].fd = remote->clients[i].fd;
+			fds[n].events = POLLIN |
+					(remote->clients[i].outLen > 0 ? POLLOUT : 0);
+			++n;
+		}
+	}
+	assert (n <= BAR_REMOTE_MAXFDS);
+
+	return n;
+}
+
+/*	Write as much of the client’s pending output as the socket accepts
+ *	@return false if the client was closed
+ */
+static bool BarRemoteFlush (BarRemoteClient_t * const client) {
+	size_t done = 0;
+	while (done < client->outLen) {
+		const ssize_t ret = write (client->fd, &client->out[done],
+				client->outLen - done);
+		if (ret == -1 && errno == EINTR) {
+			continue;
+		} else if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		} else if (ret == -1) {
+			BarRemoteClientClose (client);
+			return false;
+		}
+		done += ret;
+	}
+	client->outLen -= done;
+	memmove (client->out, &client->out[done], client->outLen);
+	return true;
+}
+
+/*	Queue one json line and send what the socket accepts. Clients that do
+ *	not read their replies and events fast enough are disconnected.
+ */
+static void BarRemoteReply (BarRemoteClient_t * const client,
+		json_object * const reply) {
+	const char * const str = json_object_to_json_string_ext (reply,
+			JSON_C_TO_STRING_PLAIN);
+	const size_t len = strlen (str);
+
+	if (client->outLen + len + 1 > BAR_REMOTE_MAXOUT) {
+		debugPrint (DEBUG_UI, "remote: client %i does not read\n", client->fd);
+		BarRemoteClientClose (client);
+		return;
+	}
+	if (client->outLen + len + 1 > client->outSize) {
+		size_t size = client->outSize > 0 ? client->outSize : 4096;
+		while (size < client->outLen + len + 1) {
+			size *= 2;
+		}
+		char * const out = realloc (client->out, size);
+		if (out == NULL) {
+			BarRemoteClientClose (client);
+			return;
+		}
+		client->out = out;
+		client->outSize = size;
+	}
+	memcpy (&client->out[client->outLen], str, len);
+	client->out[client->outLen + len] = '\n';
+	client->outLen += len + 1;
+
+	BarRemoteFlush (client);
+}
+
+/*	json string or null
+ */
+static json_object *BarRemoteString (const char * const s) {
+	return s == NULL ? NULL : json_object_new_string (s);
+}
+
+static json_object *BarRemoteSongJson (const PianoSong_t * const song) {
+	if (song == NULL) {
+		return NULL;
+	}
+
+	json_object * const o = json_object_new_object ();
+	json_object_object_add (o, "artist", BarRemoteString (song->artist));
+	json_object_object_add (o, "title", BarRemoteString (song->title));
+	json_object_object_add (o, "album", BarRemoteString (song->album));
+	json_object_object_add (o, "coverArt", BarRemoteString (song->coverArt));
+	json_object_object_add (o, "detailUrl", BarRemoteString (song->detailUrl));
+	json_object_object_add (o, "stationId", BarRemoteString (song->stationId));
+	json_object_object_add (o, "rating", json_object_new_int (song->rating));
+	json_object_object_add (o, "duration", json_object_new_int (song->length));
+	return o;
+}
+
+static json_object *BarRemoteStationJson (const PianoStation_t * const station) {
+	if (station == NULL) {
+		return NULL;
+	}
+
+	json_object * const o = json_object_new_object ();
+	json_object_object_add (o, "id", BarRemoteString (station->id));
+	json_object_object_add (o, "name", BarRemoteString (station->name));
+	json_object_object_add (o, "isQuickMix",
+			json_object_new_boolean (station->isQuickMix));
+	return o;
+}
+
+static json_object *BarRemoteStationsJson (const BarApp_t * const app) {
+	json_object * const a = json_object_new_array ();
+
+	if (app->ph.stations != NULL) {
+		size_t stationCount;
+		PianoStation_t ** const sortedStations = BarSortedStations (
+				app->ph.stations, &stationCount, app->settings.sortOrder);
+		for (size_t i = 0; i < stationCount; i++) {
+			json_object_array_add (a, BarRemoteStationJson (sortedStations[i]));
+		}
+		free (sortedStations);
+	}
+	return a;
+}
+
+static json_object *BarRemotePositionJson (const player_t * const player) {
+	json_object * const o = json_object_new_object ();
+	json_object_object_add (o, "played",
+			json_object_new_int (BarPlayerLoad (player->songPlayed)));
+	json_object_object_add (o, "playedMs",
+			json_object_new_int64 (BarPlayerGetPositionMs (player)));
+	json_object_object_add (o, "duration",
+			json_object_new_int (BarPlayerLoad (player->songDuration)));
+	return o;
+}
+
+static json_object *BarRemoteBufferJson (const BarApp_t * const app) {
+	const player_t * const player = &app->player;
+	json_object * const o = json_object_new_object ();
+	json_object_object_add (o, "health",
+			json_object_new_int (BarPlayerLoad (player->bufferHealth)));
+	const unsigned int target = BarPlayerLoad (player->bufferTarget);
+	json_object_object_add (o, "target",
+			json_object_new_int (target != 0 ? target : app->settings.bufferSecs));
+	json_object_object_add (o, "underruns",
+			json_object_new_int (BarPlayerLoad (player->underruns)));
+	json_object_object_add (o, "underrunMs",
+			json_object_new_int (BarPlayerLoad (player->underrunMs)));
+	json_object_object_add (o, "underrunPos",
+			json_object_new_int (BarPlayerLoad (player->underrunPos)));
+	return o;
+}
+
+static const char *BarRemoteModeStr (const BarPlayerMode mode) {
+	static const char * const modes[] = {"dead", "waiting", "playing",
+			"finished"};
+	assert (mode < sizeof (modes) / sizeof (*modes));
+	return modes[mode];
+}
+
+/*	Current song, NULL if nothing is playing
+ */
+static const PianoSong_t *BarRemoteCurrentSong (BarApp_t * const app) {
+	return BarPlayerGetMode (&app->player) == PLAYER_DEAD ? NULL :
+			app->playlist;
+}
+
+static json_object *BarRemoteStatusJson (BarApp_t * const app) {
+	player_t * const player = &app->player;
+	json_object * const o = json_object_new_object ();
+
+	json_object_object_add (o, "mode", json_object_new_string (
+			BarRemoteModeStr (BarPlayerGetMode (player))));
+	json_object_object_add (o, "paused",
+			json_object_new_boolean (BarPlayerLoad (player->doPause)));
+	json_object_object_add (o, "volume",
+			json_object_new_int (app->settings.volume));
+	json_object_object_add (o, "station",
+			BarRemoteStationJson (app->curStation));
+	json_object_object_add (o, "song",
+			BarRemoteSongJson (BarRemoteCurrentSong (app)));
+	json_object_object_add (o, "position", BarRemotePositionJson (player));
+	json_object_object_add (o, "buffer", BarRemoteBufferJson (app));
+	return o;
+}
+
+/*	Execute a single command
+ *	@return reply, the caller owns it
+ */
+static json_object *BarRemoteCommand (BarApp_t * const app,
+		BarRemoteClient_t * const client, const char * const cmd,
+		const char * const arg) {
+	json_object * const reply = json_object_new_object ();
+	bool ok = true;
+
+	json_object_object_add (reply, "cmd", json_object_new_string (cmd));
+
+	if (strcmp (cmd, "status") == 0) {
+		json_object_object_add (reply, "status", BarRemoteStatusJson (app));
+	} else if (strcmp (cmd, "song") == 0) {
+		json_object_object_add (reply, "song",
+				BarRemoteSongJson (BarRemoteCurrentSong (app)));
+	} else if (strcmp (cmd, "stations") == 0) {
+		json_object_object_add (reply, "stations", BarRemoteStationsJson (app));
+	} else if (strcmp (cmd, "position") == 0) {
+		json_object_object_add (reply, "position",
+				BarRemotePositionJson (&app->player));
+	} else if (strcmp (cmd, "buffer") == 0) {
+		json_object_object_add (reply, "buffer", BarRemoteBufferJson (app));
+	} else if (strcmp (cmd, "subscribe") == 0) {
+		/* optional argument: position update interval in ms */
+		unsigned long interval = 1000;
+		char *end = NULL;
+		if (arg != NULL) {
+			interval = strtoul (arg, &end, 10);
+		}
+		if (end != NULL && (end == arg || *end != '\0' || arg[0] == '-' ||
+				interval > UINT_MAX)) {
+			ok = false;
+		} else {
+			if (interval > 0 && interval < BAR_REMOTE_MINTICK) {
+				interval = BAR_REMOTE_MINTICK;
+			}
+			client->subscribed = true;
+			client->tickInterval = interval;
+			clock_gettime (CLOCK_MONOTONIC, &client->nextTick);
+			json_object_object_add (reply, "status", BarRemoteStatusJson (app));
+		}
+	} else if (strcmp (cmd, "unsubscribe") == 0) {
+		client->subscribed = false;
+	} else if (strcmp (cmd, "key") == 0 && arg != NULL && arg[0] != '\0') {
+		/* same as writing to the control fifo */
+		for (const char *c = arg; *c != '\0'; c++) {
+			if (BarUiDispatch (app, *c, app->curStation, app->playlist, true,
+					BAR_DC_GLOBAL) == BAR_KS_COUNT) {
+				ok = false;
+			}
+		}
+	} else if (strcmp (cmd, "seek") == 0 && arg != NULL && arg[0] != '\0') {
+		/* relative, in seconds */
+		char *end;
+		const long seconds = strtol (arg, &end, 10);
+		if (*end == '\0' && seconds >= INT_MIN && seconds <= INT_MAX) {
+			BarPlayerSeek (&app->player, seconds);
+		} else {
+			ok = false;
+		}
+	} else if (strncmp (cmd, "act_", 4) == 0) {
+		ok = BarUiDispatchByName (app, cmd, app->curStation, app->playlist,
+				true, BAR_DC_GLOBAL) != BAR_KS_COUNT;
+	} else {
+		json_object_object_add (reply, "error",
+				json_object_new_string ("unknown command"));
+		ok = false;
+	}
+
+	json_object_object_add (reply, "ok", json_object_new_boolean (ok));
+	return reply;
+}
+
+/*	Parse plain text or json command line and reply to it
+ */
+static void BarRemoteLine (BarApp_t * const app,
+		BarRemoteClient_t * const client, char * const line) {
+	json_object *reply = NULL;
+
+	debugPrint (DEBUG_UI, "remote: got command %s\n", line);
+
+	if (line[0] == '{') {
+		json_object * const j = json_tokener_parse (line);
+		json_object *cmd = NULL, *arg = NULL;
+		if (j != NULL) {
+			json_object_object_get_ex (j, "cmd", &cmd);
+			json_object_object_get_ex (j, "arg", &arg);
+		}
+		/* numeric arguments are passed as their string representation */
+		if (json_object_is_type (cmd, json_type_string) && (arg == NULL ||
+				json_object_is_type (arg, json_type_string) ||
+				json_object_is_type (arg, json_type_int) ||
+				json_object_is_type (arg, json_type_double))) {
+			reply = BarRemoteCommand (app, client, json_object_get_string (cmd),
+					arg == NULL ? NULL : json_object_get_string (arg));
+		} else {
+			reply = json_object_new_object ();
+			json_object_object_add (reply, "ok",
+					json_object_new_boolean (false));
+			json_object_object_add (reply, "error",
+					json_object_new_string ("invalid json"));
+		}
+		if (j != NULL) {
+			json_object_put (j);
+		}
+	} else {
+		/* command [argument] */
+		char *arg = strchr (line, ' ');
+		if (arg != NULL) {
+			*arg = '\0';
+			++arg;
+		}
+		reply = BarRemoteCommand (app, client, line, arg);
+	}
+
+	BarRemoteReply (client, reply);
+	json_object_put (reply);
+}
+
+/*	Read everything available and execute all complete lines in order
+ */
+static void BarRemoteRead (BarApp_t * const app,
+		BarRemoteClient_t * const client) {
+	while (client->fd != -1) {
+		const ssize_t ret = read (client->fd, &client->buf[client->bufLen],
+				sizeof (client->buf) - client->bufLen);
+		if (ret == 0 || (ret == -1 && errno != EAGAIN && errno != EINTR)) {
+			BarRemoteClientClose (client);
+			return;
+		} else if (ret == -1) {
+			return;
+		}
+		client->bufLen += ret;
+
+		char *start = client->buf, *end;
+		while (client->fd != -1 && (end = memchr (start, '\n',
+				client->bufLen - (start - client->buf))) != NULL) {
+			*end = '\0';
+			/* ignore cr of windows line endings and empty lines */
+			if (end > start && end[-1] == '\r') {
+				end[-1] = '\0';
+			}
+			if (*start != '\0') {
+				BarRemoteLine (app, client, start);
+			}
+			start = end+1;
+		}
+		if (client->fd == -1) {
+			return;
+		}
+		client->bufLen -= start - client->buf;
+		memmove (client->buf, start, client->bufLen);
+
+		if (client->bufLen == sizeof (client->buf)) {
+			/* line too long */
+			BarRemoteClientClose (client);
+			return;
+		}
+	}
+}
+
+static void BarRemoteAccept (BarRemote_t * const remote) {
+	int fd;
+	while ((fd = accept (remote->fd, NULL, NULL)) != -1) {
+		BarRemoteClient_t *client = NULL;
+		for (size_t i = 0; i < BAR_REMOTE_MAXCLIENTS; i++) {
+			if (remote->clients[i].fd == -1) {
+				client = &remote->clients[i];
+				break;
+			}
+		}
+		if (client == NULL) {
+			debugPrint (DEBUG_UI, "remote: too many clients\n");
+			close (fd);
+			continue;
+		}
+		BarRemoteSetFlags (fd);
+		client->fd = fd;
+		client->bufLen = 0;
+		debugPrint (DEBUG_UI, "remote: new client %i\n", fd);
+	}
+}
+
+/*	Handle poll() result
+ *	@param app
+ *	@param fds filled by BarRemotePollFds
+ *	@param number of fds
+ */
+void BarRemoteHandle (BarApp_t * const app, const struct pollfd * const fds,
+		const size_t n) {
+	BarRemote_t * const remote = &app->remote;
+
+	for (size_t i = 0; i < n; i++) {
+		if (fds[i].revents == 0) {
+			continue;
+		}
+		if (fds[i].fd == remote->fd) {
+			BarRemoteAccept (remote);
+			continue;
+		}
+		for (size_t j = 0; j < BAR_REMOTE_MAXCLIENTS; j++) {
+			BarRemoteClient_t * const client = &remote->clients[j];
+			if (client->fd == fds[i].fd) {
+				if ((fds[i].revents & POLLOUT) && !BarRemoteFlush (client)) {
+					break;
+				}
+				if (fds[i].revents & ~POLLOUT) {
+					BarRemoteRead (app, client);
+				}
+				break;
+			}
+		}
+	}
+}
+
+/*	Send message to all subscribers
+ */
+static void BarRemoteBroadcast (BarRemote_t * const remote,
+		json_object * const msg) {
+	for (size_t i = 0; i < BAR_REMOTE_MAXCLIENTS; i++) {
+		BarRemoteClient_t * const client = &remote->clients[i];
+		if (client->fd != -1 && client->subscribed) {
+			BarRemoteReply (client, msg);
+		}
+	}
+	json_object_put (msg);
+}
+
+static bool BarRemoteHasSubscribers (const BarRemote_t * const remote) {
+	for (size_t i = 0; i < BAR_REMOTE_MAXCLIENTS; i++) {
+		if (remote->clients[i].fd != -1 && remote->clients[i].subscribed) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static json_object *BarRemoteEventJson (const char * const type) {
+	json_object * const o = json_object_new_object ();
+	json_object_object_add (o, "event", json_object_new_string (type));
+	return o;
+}
+
+/*	Broadcast eventcmd event, called by BarUiStartEventCmd
+ */
+void BarRemoteEvent (BarRemote_t * const remote, const char * const type,
+		const PianoStation_t * const curStation,
+		const PianoSong_t * const curSong, player_t * const player,
+		const PianoReturn_t pRet, const CURLcode wRet) {
+	if (!BarRemoteHasSubscribers (remote)) {
+		return;
+	}
+
+	json_object * const o = BarRemoteEventJson (type);
+	json_object_object_add (o, "pRet", json_object_new_int (pRet));
+	json_object_object_add (o, "pRetStr",
+			json_object_new_string (PianoErrorToStr (pRet)));
+	json_object_object_add (o, "wRet", json_object_new_int (wRet));
+	json_object_object_add (o, "wRetStr",
+			json_object_new_string (curl_easy_strerror (wRet)));
+	json_object_object_add (o, "station", BarRemoteStationJson (curStation));
+	json_object_object_add (o, "song", BarRemoteSongJson (curSong));
+	json_object_object_add (o, "position", BarRemotePositionJson (player));
+	BarRemoteBroadcast (remote, o);
+}
+
+/*	true if position updates are sent right now
+ */
+static bool BarRemoteTicking (BarApp_t * const app) {
+	return BarPlayerGetMode (&app->player) == PLAYER_PLAYING &&
+			!BarPlayerLoad (app->player.doPause);
+}
+
+static long long BarRemoteMsUntil (const struct timespec * const t,
+		const struct timespec * const now) {
+	return (t->tv_sec - now->tv_sec) * 1000LL +
+			(t->tv_nsec - now->tv_nsec) / 1000000;
+}
+
+/*	Send state changes and position updates to subscribers, called from the
+ *	main loop
+ */
+void BarRemoteUpdate (BarApp_t * const app) {
+	BarRemote_t * const remote = &app->remote;
+	player_t * const player = &app->player;
+
+	if (!BarRemoteHasSubscribers (remote)) {
+		return;
+	}
+
+	const BarPlayerMode mode = BarPlayerGetMode (player);
+	if (mode != remote->last.mode) {
+		remote->last.mode = mode;
+		json_object * const o = BarRemoteEventJson ("mode");
+		json_object_object_add (o, "mode",
+				json_object_new_string (BarRemoteModeStr (mode)));
+		BarRemoteBroadcast (remote, o);
+	}
+
+	const bool paused = BarPlayerLoad (player->doPause);
+	if (paused != remote->last.paused) {
+		remote->last.paused = paused;
+		json_object * const o = BarRemoteEventJson ("pause");
+		json_object_object_add (o, "paused", json_object_new_boolean (paused));
+		BarRemoteBroadcast (remote, o);
+	}
+
+	if (app->settings.volume != remote->last.volume) {
+		remote->last.volume = app->settings.volume;
+		json_object * const o = BarRemoteEventJson ("volume");
+		json_object_object_add (o, "volume",
+				json_object_new_int (app->settings.volume));
+		BarRemoteBroadcast (remote, o);
+	}
+
+	const unsigned int bufferHealth = BarPlayerLoad (player->bufferHealth);
+	if (bufferHealth != remote->last.bufferHealth) {
+		remote->last.bufferHealth = bufferHealth;
+		json_object * const o = BarRemoteEventJson ("buffer");
+		json_object_object_add (o, "buffer", BarRemoteBufferJson (app));
+		BarRemoteBroadcast (remote, o);
+	}
+
+	if (!BarRemoteTicking (app)) {
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	json_object *position = NULL;
+	for (size_t i = 0; i < BAR_REMOTE_MAXCLIENTS; i++) {
+		BarRemoteClient_t * const client = &remote->clients[i];
+		if (client->fd == -1 || !client->subscribed ||
+				client->tickInterval == 0 ||
+				BarRemoteMsUntil (&client->nextTick, &now) > 0) {
+			continue;
+		}
+		if (position == NULL) {
+			position = BarRemoteEventJson ("position");
+			json_object_object_add (position, "position",
+					BarRemotePositionJson (player));
+		}
+		BarRemoteReply (client, position);
+		/* do not try to catch up on missed ticks */
+		client->nextTick = now;
+		client->nextTick.tv_sec += client->tickInterval / 1000;
+		client->nextTick.tv_nsec += (client->tickInterval % 1000) * 1000000;
+		if (client->nextTick.tv_nsec >= 1000000000) {
+			client->nextTick.tv_nsec -= 1000000000;
+			++client->nextTick.tv_sec;
+		}
+	}
+	if (position != NULL) {
+		json_object_put (position);
+	}
+}
+
+/*	Time until the next position update is due
+ *	@return milliseconds or -1
+ */
+int BarRemoteTimeout (BarApp_t * const app) {
+	BarRemote_t * const remote = &app->remote;
+	long long timeout = -1;
+
+	if (!BarRemoteTicking (app)) {
+		return -1;
+	}
+
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	for (size_t i = 0; i < BAR_REMOTE_MAXCLIENTS; i++) {
+		const BarRemoteClient_t * const client = &remote->clients[i];
+		if (client->fd == -1 || !client->subscribed ||
+				client->tickInterval == 0) {
+			continue;
+		}
+		long long t = BarRemoteMsUntil (&client->nextTick, &now);
+		if (t < 0) {
+			t = 0;
+		}
+		if (timeout == -1 || t < timeout) {
+			timeout = t;
+		}
+	}
+	return timeout;
+}
+
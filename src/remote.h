@@ -0,0 +1,84 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <poll.h>
+#include <time.h>
+
+#include <curl/curl.h>
+#include <piano.h>
+
+#include "player.h"
+
+#define BAR_REMOTE_MAXCLIENTS 16
+/* listening socket and all clients */
+#define BAR_REMOTE_MAXFDS (BAR_REMOTE_MAXCLIENTS+1)
+/* shortest position update interval in ms */
+#define BAR_REMOTE_MINTICK 50
+/* clients with more unsent output are disconnected */
+#define BAR_REMOTE_MAXOUT (256*1024)
+
+typedef struct {
+	int fd;
+	/* incomplete command line */
+	char buf[1024];
+	size_t bufLen;
+	/* replies and events the socket did not accept yet, sent on POLLOUT */
+	char *out;
+	size_t outLen, outSize;
+	/* receives events and state changes */
+	bool subscribed;
+	/* position updates, in milliseconds, 0 disables them */
+	unsigned int tickInterval;
+	struct timespec nextTick;
+} BarRemoteClient_t;
+
+typedef struct {
+	/* listening socket, -1 if disabled */
+	int fd;
+	char *path;
+	BarRemoteClient_t clients[BAR_REMOTE_MAXCLIENTS];
+	/* last state sent to subscribers */
+	struct {
+		BarPlayerMode mode;
+		bool paused;
+		int volume;
+		unsigned int bufferHealth;
+	} last;
+} BarRemote_t;
+
+struct BarApp;
+
+void BarRemoteInit (BarRemote_t *);
+bool BarRemoteOpen (BarRemote_t *, const char *);
+void BarRemoteDestroy (BarRemote_t *);
+size_t BarRemotePollFds (const BarRemote_t *, struct pollfd *);
+void BarRemoteHandle (struct BarApp *, const struct pollfd *, size_t);
+void BarRemoteEvent (BarRemote_t *, const char *, const PianoStation_t *,
+		const PianoSong_t *, player_t *, PianoReturn_t, CURLcode);
+void BarRemoteUpdate (struct BarApp *);
+int BarRemoteTimeout (struct BarApp *);
+
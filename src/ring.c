@@ -0,0 +1,144 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* block queue between decoder and output thread.
+ *
+ * All memory is allocated and, if requested, locked and prefaulted up
+ * front. The producer fills the block returned by BarRingWritable and
+ * publishes it with BarRingPush, the consumer reads BarRingReadable and
+ * returns it with BarRingPop. Waiting for the other side is up to the
+ * caller.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "ring.h"
+#include "debug.h"
+
+void BarRingInit (BarRing_t * const ring) {
+	memset (ring, 0, sizeof (*ring));
+}
+
+/*	Allocate count blocks of blockSize bytes. Existing memory is reused if
+ *	the geometry matches. Must not be called while the ring is in use.
+ *	@param lock memory into RAM
+ *	@return false if out of memory
+ */
+bool BarRingAlloc (BarRing_t * const ring, const size_t count,
+		const size_t blockSize, const bool lock) {
+	assert (ring != NULL);
+	assert (count > 0 && blockSize > 0);
+
+	if (ring->count == count && ring->blockSize == blockSize &&
+			ring->locked == lock) {
+		BarRingClear (ring);
+		return true;
+	}
+
+	BarRingFree (ring);
+	ring->blocks = calloc (count, sizeof (*ring->blocks));
+	ring->mem = malloc (count * blockSize);
+	if (ring->blocks == NULL || ring->mem == NULL) {
+		BarRingFree (ring);
+		return false;
+	}
+	/* prefault, so the first pass does not take page faults */
+	memset (ring->mem, 0, count * blockSize);
+	ring->count = count;
+	ring->blockSize = blockSize;
+	for (size_t i = 0; i < count; i++) {
+		ring->blocks[i].data = &ring->mem[i * blockSize];
+	}
+	if (lock) {
+		ring->locked = mlock (ring->blocks, count * sizeof (*ring->blocks)) == 0 &&
+				mlock (ring->mem, count * blockSize) == 0;
+		debugPrint (DEBUG_AUDIO, "ring has %zu blocks of %zu bytes, %slocked\n",
+				count, blockSize, ring->locked ? "" : "not ");
+	}
+	BarRingClear (ring);
+
+	return true;
+}
+
+void BarRingFree (BarRing_t * const ring) {
+	if (ring->locked) {
+		munlock (ring->blocks, ring->count * sizeof (*ring->blocks));
+		munlock (ring->mem, ring->count * ring->blockSize);
+	}
+	free (ring->blocks);
+	free (ring->mem);
+	BarRingInit (ring);
+}
+
+/*	Drop all blocks, both sides must be idle
+ */
+void BarRingClear (BarRing_t * const ring) {
+	__atomic_store_n (&ring->head, 0, __ATOMIC_RELEASE);
+	__atomic_store_n (&ring->tail, 0, __ATOMIC_RELEASE);
+}
+
+size_t BarRingUsed (const BarRing_t * const ring) {
+	return __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE) -
+			__atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+/*	Next free block, NULL if the ring is full. Producer only.
+ */
+BarRingBlock_t *BarRingWritable (BarRing_t * const ring) {
+	const size_t head = __atomic_load_n (&ring->head, __ATOMIC_RELAXED);
+	if (ring->count == 0 ||
+			head - __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE) >= ring->count) {
+		return NULL;
+	}
+	return &ring->blocks[head % ring->count];
+}
+
+/*	Publish the block returned by BarRingWritable
+ */
+void BarRingPush (BarRing_t * const ring) {
+	__atomic_store_n (&ring->head,
+			__atomic_load_n (&ring->head, __ATOMIC_RELAXED) + 1, __ATOMIC_RELEASE);
+}
+
+/*	Oldest block, NULL if the ring is empty. Consumer only.
+ */
+BarRingBlock_t *BarRingReadable (BarRing_t * const ring) {
+	const size_t tail = __atomic_load_n (&ring->tail, __ATOMIC_RELAXED);
+	if (__atomic_load_n (&ring->head, __ATOMIC_ACQUIRE) == tail) {
+		return NULL;
+	}
+	return &ring->blocks[tail % ring->count];
+}
+
+/*	Return the block returned by BarRingReadable
+ */
+void BarRingPop (BarRing_t * const ring) {
+	__atomic_store_n (&ring->tail,
+			__atomic_load_n (&ring->tail, __ATOMIC_RELAXED) + 1, __ATOMIC_RELEASE);
+}
+
@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* block of PCM samples */
+typedef struct {
+	uint8_t *data;
+	size_t len;
+	/* stream position of the first sample in seconds */
+	double timestamp;
+	/* end of stream, no data */
+	bool eof;
+	/* set by the producer, lets the consumer recognize stale blocks */
+	unsigned int epoch;
+} BarRingBlock_t;
+
+/* single producer, single consumer queue of preallocated blocks. Neither
+ * side allocates or locks, so it can be used from real-time threads. */
+typedef struct {
+	BarRingBlock_t *blocks;
+	uint8_t *mem;
+	size_t count, blockSize;
+	/* free-running, head is written by the producer only, tail by the
+	 * consumer only */
+	size_t head, tail;
+	/* memory is locked */
+	bool locked;
+} BarRing_t;
+
+void BarRingInit (BarRing_t * const);
+bool BarRingAlloc (BarRing_t * const, const size_t, const size_t, const bool);
+void BarRingFree (BarRing_t * const);
+void BarRingClear (BarRing_t * const);
+size_t BarRingUsed (const BarRing_t * const);
+BarRingBlock_t *BarRingWritable (BarRing_t * const);
+void BarRingPush (BarRing_t * const);
+BarRingBlock_t *BarRingReadable (BarRing_t * const);
+void BarRingPop (BarRing_t * const);
+
@@ -126,7 +126,12 @@ void BarSettingsDestroy (BarSettings_t *settings) {
 	free (settings->listSongFormat);
 	free (settings->timeFormat);
 	free (settings->fifo);
+	free (settings->controlSocket);
 	free (settings->audioPipe);
+	free (settings->audioSinks);
+	free (settings->audioOutput);
+	free (settings->audioDevice);
+	free (settings->httpAddress);
 	free (settings->rpcHost);
 	free (settings->rpcTlsPort);
 	free (settings->partnerUser);
@@ -161,6 +166,14 @@ void BarSettingsRead (BarSettings_t *settings) {
 	/* apply defaults */
 	settings->audioQuality = PIANO_AQ_HIGH;
 	settings->autoselect = true;
+	settings->audioRealtime = false;
+	settings->audioCpu = -1;
+	settings->audioPauseRelease = false;
+	settings->audioPeriod = 0;
+	settings->audioLatency = 0;
+	settings->audioDither = false;
+	settings->crossfade = 0;
+	settings->seekStep = 10;
 	settings->history = 5;
 	settings->volume = 0;
 	settings->timeout = 30; /* seconds */
@@ -168,6 +181,10 @@ void BarSettingsRead (BarSettings_t *settings) {
 	/* should be > 4, otherwise expired audio urls (403) can stop playback */
 	settings->maxRetry = 5;
 	settings->bufferSecs = 5;
+	settings->bufferBytes = 0;
+	settings->bufferMinSecs = 2;
+	settings->bufferMaxSecs = 60;
+	settings->downloadBuffer = 2*1024*1024;
 	settings->sortOrder = BAR_SORT_NAME_AZ;
 	settings->loveIcon = strdup (" <3");
 	settings->banIcon = strdup (" </3");
@@ -186,6 +203,12 @@ void BarSettingsRead (BarSettings_t *settings) {
 	settings->outkey = strdup ("6#26FRL$ZWD");
 	settings->fifo = BarGetXdgConfigDir (PACKAGE "/ctl");
 	settings->audioPipe = NULL;
+	settings->audioSinks = NULL;
+	settings->audioOutput = strdup ("ao");
+	settings->audioDevice = NULL;
+	settings->httpAddress = strdup ("127.0.0.1");
+	settings->httpPort = 0;
+	settings->audioPipeFormat = BAR_MIX_S16;
 	assert (settings->fifo != NULL);
 	settings->sampleRate = 0; /* default to stream sample rate */
 
@@ -337,6 +360,8 @@ void BarSettingsRead (BarSettings_t *settings) {
 					settings->audioQuality = PIANO_AQ_MEDIUM;
 				} else if (streq (val, "high")) {
 					settings->audioQuality = PIANO_AQ_HIGH;
+				} else if (streq (val, "auto")) {
+					settings->audioQuality = PIANO_AQ_UNKNOWN;
 				}
 			} else if (streq ("autostart_station", key)) {
 				free (settings->autostartStation);
@@ -351,6 +376,17 @@ void BarSettingsRead (BarSettings_t *settings) {
 				settings->timeout = atoi (val);
 			} else if (streq ("buffer_seconds", key)) {
 				settings->bufferSecs = atoi (val);
+			} else if (streq ("buffer_seconds_min", key)) {
+				settings->bufferMinSecs = atoi (val);
+			} else if (streq ("buffer_seconds_max", key)) {
+				settings->bufferMaxSecs = atoi (val);
+			} else if (streq ("buffer_bytes", key)) {
+				settings->bufferBytes = atoi (val);
+			} else if (streq ("download_buffer", key)) {
+				settings->downloadBuffer = atoi (val);
+				if (settings->downloadBuffer < 64*1024) {
+					settings->downloadBuffer = 64*1024;
+				}
 			} else if (streq ("sort", key)) {
 				size_t i;
 				static const char *mapping[] = {"name_az",
@@ -397,9 +433,50 @@ void BarSettingsRead (BarSettings_t *settings) {
 			} else if (streq ("fifo", key)) {
 				free (settings->fifo);
 				settings->fifo = BarSettingsExpandTilde (val, userhome);
+			} else if (streq ("control_socket", key)) {
+				free (settings->controlSocket);
+				settings->controlSocket = BarSettingsExpandTilde (val, userhome);
 			} else if (streq ("audio_pipe", key)) {
 				free (settings->audioPipe);
 				settings->audioPipe = BarSettingsExpandTilde (val, userhome);
+			} else if (streq ("audio_output", key)) {
+				free (settings->audioOutput);
+				settings->audioOutput = strdup (val);
+			} else if (streq ("audio_device", key)) {
+				free (settings->audioDevice);
+				settings->audioDevice = BarSettingsExpandTilde (val, userhome);
+			} else if (streq ("http_address", key)) {
+				free (settings->httpAddress);
+				settings->httpAddress = strdup (val);
+			} else if (streq ("http_port", key)) {
+				settings->httpPort = atoi (val);
+			} else if (streq ("audio_sinks", key)) {
+				free (settings->audioSinks);
+				settings->audioSinks = strdup (val);
+			} else if (streq ("audio_pipe_format", key)) {
+				if (streq (val, "s16")) {
+					settings->audioPipeFormat = BAR_MIX_S16;
+				} else if (streq (val, "s32")) {
+					settings->audioPipeFormat = BAR_MIX_S32;
+				} else if (streq (val, "f32")) {
+					settings->audioPipeFormat = BAR_MIX_F32;
+				}
+			} else if (streq ("audio_realtime", key)) {
+				settings->audioRealtime = atoi (val);
+			} else if (streq ("audio_pause_release", key)) {
+				settings->audioPauseRelease = atoi (val);
+			} else if (streq ("audio_cpu", key)) {
+				settings->audioCpu = atoi (val);
+			} else if (streq ("audio_period", key)) {
+				settings->audioPeriod = atoi (val);
+			} else if (streq ("audio_latency", key)) {
+				settings->audioLatency = atoi (val);
+			} else if (streq ("audio_dither", key)) {
+				settings->audioDither = atoi (val);
+			} else if (streq ("crossfade", key)) {
+				settings->crossfade = atoi (val);
+			} else if (streq ("seek_step", key)) {
+				settings->seekStep = atoi (val);
 			} else if (streq ("autoselect", key)) {
 				settings->autoselect = atoi (val);
 			} else if (streq ("sample_rate", key)) {
@@ -444,6 +521,12 @@ void BarSettingsRead (BarSettings_t *settings) {
 		free (path);
 	}
 
+	/* limits of the adaptive buffer, independent of their order in the
+	 * config file */
+	if (settings->bufferMaxSecs < settings->bufferMinSecs) {
+		settings->bufferMaxSecs = settings->bufferMinSecs;
+	}
+
 	/* check environment variable if proxy is not set explicitly */
 	if (settings->proxy == NULL) {
 		char *tmpProxy = getenv ("http_proxy");
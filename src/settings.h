@@ -59,8 +59,10 @@ typedef enum {
 	BAR_KS_PAUSE = 27,
 	BAR_KS_VOLRESET = 28,
 	BAR_KS_SETTINGS = 29,
+	BAR_KS_SEEKBACK = 30,
+	BAR_KS_SEEKFORWARD = 31,
 	/* insert new shortcuts _before_ this element and increase its value */
-	BAR_KS_COUNT = 30,
+	BAR_KS_COUNT = 32,
 } BarKeyShortcutId_t;
 
 #define BAR_KS_DISABLED '\x00'
@@ -81,13 +83,28 @@ typedef struct {
 } BarMsgFormatStr_t;
 
 #include "ui_types.h"
+#include "mix.h"
 
 typedef struct {
 	bool autoselect;
-	unsigned int history, maxRetry, timeout, bufferSecs;
+	/* real-time output thread, pinned to audioCpu (-1 is the last cpu) */
+	bool audioRealtime;
+	int audioCpu;
+	/* close the audio device while paused */
+	bool audioPauseRelease;
+	/* milliseconds of audio per write, 0 is about 20 ms */
+	unsigned int audioPeriod;
+	/* milliseconds buffered by the device, 0 to estimate it */
+	unsigned int audioLatency;
+	bool audioDither;
+	/* seconds */
+	unsigned int crossfade, seekStep;
+	unsigned int history, maxRetry, timeout, bufferSecs, bufferBytes,
+			downloadBuffer, bufferMinSecs, bufferMaxSecs;
 	int volume;
 	float gainMul;
 	BarStationSorting_t sortOrder;
+	/* PIANO_AQ_UNKNOWN adapts to the network speed */
 	PianoAudioQuality_t audioQuality;
 	char *username;
 	char *password, *passwordCmd;
@@ -102,8 +119,16 @@ typedef struct {
 	char *npStationFormat;
 	char *listSongFormat, *timeFormat;
 	char *fifo;
+	char *controlSocket;
 	char *rpcHost, *rpcTlsPort, *partnerUser, *partnerPassword, *device, *inkey, *outkey, *caBundle;
 	char *audioPipe;
+	char *audioSinks;
+	/* output backend, see output.c, and its device (ALSA pcm or file) */
+	char *audioOutput, *audioDevice;
+	/* built-in stream server, disabled if the port is 0 */
+	char *httpAddress;
+	unsigned int httpPort;
+	BarMixFormat_t audioPipeFormat;
 	char keys[BAR_KS_COUNT];
 	int sampleRate;
 	BarMsgFormatStr_t msgFormat[MSG_COUNT];
@@ -0,0 +1,314 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/* audio fan-out to pipes and sockets.
+ *
+ * The output worker copies every block it plays into each sink’s queue,
+ * without blocking or allocating. A single thread writes the queues to their
+ * file descriptors. If a sink is too slow its queue fills up and further
+ * blocks are dropped for this sink only; the device and all other sinks are
+ * not affected. Sinks that are not connected are retried once per second.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "sink.h"
+#include "debug.h"
+
+#define QUEUE_MASK (BAR_SINK_QUEUE-1)
+
+static long monotonicSecs (void) {
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+static void setFlags (const int fd) {
+	fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+	fcntl (fd, F_SETFD, FD_CLOEXEC);
+}
+
+void BarSinksInit (BarSinks_t * const sinks) {
+	assert (sinks != NULL);
+
+	memset (sinks, 0, sizeof (*sinks));
+	sinks->wakeFd[0] = sinks->wakeFd[1] = -1;
+	for (size_t i = 0; i < BAR_SINK_MAX; i++) {
+		sinks->sinks[i].fd = -1;
+	}
+}
+
+/*	Try to connect a sink, does not block
+ */
+static void sinkConnect (BarSink_t * const sink) {
+	int fd = -1;
+
+	switch (sink->type) {
+		case BAR_SINK_PIPE:
+			/* fails with ENXIO if there is no reader yet */
+			fd = open (sink->path, O_WRONLY | O_NONBLOCK);
+			break;
+
+		case BAR_SINK_UNIX: {
+			struct sockaddr_un addr;
+			memset (&addr, 0, sizeof (addr));
+			addr.sun_family = AF_UNIX;
+			strcpy (addr.sun_path, sink->path);
+			if ((fd = socket (AF_UNIX, SOCK_STREAM, 0)) != -1 &&
+					connect (fd, (struct sockaddr *) &addr,
+					sizeof (addr)) == -1) {
+				close (fd);
+				fd = -1;
+			}
+			break;
+		}
+	}
+
+	if (fd == -1) {
+		sink->retry = monotonicSecs () + 1;
+		return;
+	}
+	setFlags (fd);
+	debugPrint (DEBUG_AUDIO, "sink %s connected\n", sink->path);
+	sink->fd = fd;
+	/* anything queued before is stale */
+	__atomic_store_n (&sink->tail, __atomic_load_n (&sink->head,
+			__ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+	__atomic_store_n (&sink->up, true, __ATOMIC_RELEASE);
+}
+
+static void sinkDisconnect (BarSink_t * const sink) {
+	debugPrint (DEBUG_AUDIO, "sink %s disconnected, %lu blocks dropped\n",
+			sink->path, __atomic_load_n (&sink->dropped, __ATOMIC_RELAXED));
+	__atomic_store_n (&sink->up, false, __ATOMIC_RELEASE);
+	close (sink->fd);
+	sink->fd = -1;
+	sink->retry = monotonicSecs () + 1;
+}
+
+static size_t sinkQueued (const BarSink_t * const sink) {
+	return __atomic_load_n (&sink->head, __ATOMIC_ACQUIRE) - sink->tail;
+}
+
+/*	Write as much of the queue as the sink accepts
+ */
+static void sinkFlush (BarSink_t * const sink) {
+	size_t queued;
+	while ((queued = sinkQueued (sink)) > 0) {
+		const size_t off = sink->tail & QUEUE_MASK,
+				len = BAR_SINK_QUEUE - off < queued ? BAR_SINK_QUEUE - off :
+				queued;
+		const ssize_t ret = write (sink->fd, &sink->queue[off], len);
+		if (ret > 0) {
+			__atomic_store_n (&sink->tail, sink->tail + ret, __ATOMIC_RELEASE);
+		} else if (ret == -1 && errno == EINTR) {
+			continue;
+		} else if (ret == -1 && errno == EAGAIN) {
+			break;
+		} else {
+			sinkDisconnect (sink);
+			break;
+		}
+	}
+}
+
+static void *sinkThread (void *data) {
+	BarSinks_t * const sinks = data;
+
+	while (!__atomic_load_n (&sinks->terminate, __ATOMIC_ACQUIRE)) {
+		struct pollfd pfd[BAR_SINK_MAX+1];
+		int timeout = -1;
+
+		pfd[0].fd = sinks->wakeFd[0];
+		pfd[0].events = POLLIN;
+		for (size_t i = 0; i < sinks->count; i++) {
+			BarSink_t * const sink = &sinks->sinks[i];
+			if (sink->fd == -1 && monotonicSecs () >= sink->retry) {
+				sinkConnect (sink);
+			}
+			if (sink->fd == -1) {
+				timeout = 1000;
+			}
+			/* POLLHUP and POLLERR are reported anyway */
+			pfd[i+1].fd = sink->fd;
+			pfd[i+1].events = sinkQueued (sink) > 0 ? POLLOUT : 0;
+		}
+
+		poll (pfd, sinks->count+1, timeout);
+		char buf[16];
+		while (read (sinks->wakeFd[0], buf, sizeof (buf)) > 0);
+
+		for (size_t i = 0; i < sinks->count; i++) {
+			BarSink_t * const sink = &sinks->sinks[i];
+			if (sink->fd == -1) {
+				continue;
+			}
+			if (pfd[i+1].revents & (POLLHUP | POLLERR)) {
+				sinkDisconnect (sink);
+			} else {
+				sinkFlush (sink);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*	Parse a comma-separated list of pipe:/path and unix:/path and start the
+ *	sink thread
+ */
+bool BarSinksOpen (BarSinks_t * const sinks, const char * const spec) {
+	assert (sinks != NULL);
+	assert (spec != NULL);
+
+	char * const copy = strdup (spec);
+	bool ret = true;
+	char *save = NULL;
+	for (char *tok = strtok_r (copy, ",", &save); tok != NULL && ret;
+			tok = strtok_r (NULL, ",", &save)) {
+		while (*tok == ' ' || *tok == '\t') {
+			++tok;
+		}
+		char *end = tok + strlen (tok);
+		while (end > tok && (end[-1] == ' ' || end[-1] == '\t')) {
+			*--end = '\0';
+		}
+
+		if (sinks->count >= BAR_SINK_MAX) {
+			ret = false;
+			break;
+		}
+		BarSink_t * const sink = &sinks->sinks[sinks->count];
+		const char *path = NULL;
+		if (strncmp (tok, "pipe:", 5) == 0) {
+			sink->type = BAR_SINK_PIPE;
+			path = tok + 5;
+		} else if (strncmp (tok, "unix:", 5) == 0) {
+			struct sockaddr_un addr;
+			sink->type = BAR_SINK_UNIX;
+			path = tok + 5;
+			if (strlen (path) >= sizeof (addr.sun_path)) {
+				path = NULL;
+			}
+		}
+		if (path == NULL || *path == '\0') {
+			ret = false;
+			break;
+		}
+		if ((sink->queue = malloc (BAR_SINK_QUEUE)) == NULL) {
+			ret = false;
+			break;
+		}
+		sink->path = strdup (path);
+		++sinks->count;
+	}
+	free (copy);
+
+	if (!ret || sinks->count == 0) {
+		return false;
+	}
+
+	if (pipe (sinks->wakeFd) == -1) {
+		sinks->wakeFd[0] = sinks->wakeFd[1] = -1;
+		return false;
+	}
+	setFlags (sinks->wakeFd[0]);
+	setFlags (sinks->wakeFd[1]);
+	if (pthread_create (&sinks->thread, NULL, sinkThread, sinks) != 0) {
+		return false;
+	}
+	sinks->running = true;
+
+	return true;
+}
+
+/*	Queue one block for every sink. Never blocks or allocates, called by the
+ *	output worker.
+ */
+void BarSinksFeed (BarSinks_t * const sinks, const void * const data,
+		const size_t len) {
+	bool queued = false;
+
+	for (size_t i = 0; i < sinks->count; i++) {
+		BarSink_t * const sink = &sinks->sinks[i];
+		const size_t head = sink->head,
+				used = head - __atomic_load_n (&sink->tail, __ATOMIC_ACQUIRE);
+		if (!__atomic_load_n (&sink->up, __ATOMIC_ACQUIRE) ||
+				BAR_SINK_QUEUE - used < len) {
+			__atomic_add_fetch (&sink->dropped, 1, __ATOMIC_RELAXED);
+			continue;
+		}
+		const size_t off = head & QUEUE_MASK,
+				first = BAR_SINK_QUEUE - off < len ? BAR_SINK_QUEUE - off : len;
+		memcpy (&sink->queue[off], data, first);
+		memcpy (sink->queue, (const uint8_t *) data + first, len - first);
+		__atomic_store_n (&sink->head, head + len, __ATOMIC_RELEASE);
+		queued = true;
+	}
+
+	if (queued && sinks->wakeFd[1] != -1) {
+		const char c = 0;
+		/* a full pipe is fine, the thread will wake up anyway */
+		if (write (sinks->wakeFd[1], &c, sizeof (c)) == -1) {
+			assert (errno == EAGAIN || errno == EWOULDBLOCK);
+		}
+	}
+}
+
+void BarSinksDestroy (BarSinks_t * const sinks) {
+	assert (sinks != NULL);
+
+	if (sinks->running) {
+		__atomic_store_n (&sinks->terminate, true, __ATOMIC_RELEASE);
+		const char c = 0;
+		if (write (sinks->wakeFd[1], &c, sizeof (c)) == -1) {
+			assert (errno == EAGAIN || errno == EWOULDBLOCK);
+		}
+		pthread_join (sinks->thread, NULL);
+	}
+	for (size_t i = 0; i < BAR_SINK_MAX; i++) {
+		BarSink_t * const sink = &sinks->sinks[i];
+		if (sink->fd != -1) {
+			close (sink->fd);
+		}
+		free (sink->queue);
+		free (sink->path);
+	}
+	for (size_t i = 0; i < 2; i++) {
+		if (sinks->wakeFd[i] != -1) {
+			close (sinks->wakeFd[i]);
+		}
+	}
+	BarSinksInit (sinks);
+}
@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2026
+	agent <agent@local>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define BAR_SINK_MAX 8
+/* per-sink queue in bytes, power of two. About three seconds of 32 bit
+ * stereo audio at 44.1 kHz. */
+#define BAR_SINK_QUEUE (1024*1024)
+
+typedef enum {
+	BAR_SINK_PIPE = 0,
+	BAR_SINK_UNIX,
+} BarSinkType_t;
+
+typedef struct {
+	BarSinkType_t type;
+	char *path;
+	/* owned by the sink thread, -1 while disconnected */
+	int fd;
+	/* set by the sink thread, data is dropped while it is false */
+	bool up;
+	/* byte queue, head is written by the producer only, tail by the sink
+	 * thread only */
+	uint8_t *queue;
+	size_t head, tail;
+	/* blocks dropped because the sink was too slow or disconnected */
+	unsigned long dropped;
+	/* earliest reconnect attempt, monotonic seconds */
+	long retry;
+} BarSink_t;
+
+/* additional outputs, fed with the same samples as the audio device */
+typedef struct {
+	BarSink_t sinks[BAR_SINK_MAX];
+	size_t count;
+	/* wakes the sink thread */
+	int wakeFd[2];
+	pthread_t thread;
+	bool running, terminate;
+} BarSinks_t;
+
+void BarSinksInit (BarSinks_t * const);
+bool BarSinksOpen (BarSinks_t * const, const char * const);
+void BarSinksFeed (BarSinks_t * const, const void * const, const size_t);
+void BarSinksDestroy (BarSinks_t * const);
@@ -422,7 +422,7 @@ static int BarStationCmpQuickmix10NameZA (const void *a, const void *b) {
  *	@param stations
  *	@return NULL-terminated array with sorted stations
  */
-static PianoStation_t **BarSortedStations (PianoStation_t *unsortedStations,
+PianoStation_t **BarSortedStations (PianoStation_t *unsortedStations,
 		size_t *retStationCount, BarStationSorting_t order) {
 	static const BarSortFunc_t orderMapping[] = {BarStationNameAZCmp,
 			BarStationNameZACmp,
@@ -887,20 +887,24 @@ static void BarUiEventcmdPrintSong (FILE * restrict stream,
 			);
 }
 
-/*	Excute external event handler
- *	@param settings containing the cmdline
+/*	Excute external event handler and notify remote subscribers
+ *	@param app handle
  *	@param event type
  *	@param current station
  *	@param current song
  *	@param piano error-code (PIANO_RET_OK if not applicable)
  */
-void BarUiStartEventCmd (const BarSettings_t *settings, const char *type,
+void BarUiStartEventCmd (BarApp_t *app, const char *type,
 		const PianoStation_t *curStation, const PianoSong_t *curSong,
 		player_t * const player, PianoStation_t *stations,
 		PianoReturn_t pRet, CURLcode wRet) {
+	const BarSettings_t * const settings = &app->settings;
 	pid_t chld;
 	int pipeFd[2];
 
+	BarRemoteEvent (&app->remote, type, curStation, curSong, player, pRet,
+			wRet);
+
 	if (settings->eventCmd == NULL) {
 		/* nothing to do... */
 		return;
@@ -937,10 +941,8 @@ void BarUiStartEventCmd (const BarSettings_t *settings, const char *type,
 			songStation = PianoFindStationById (stations, curSong->stationId);
 		}
 
-		pthread_mutex_lock (&player->lock);
-		const unsigned int songDuration = player->songDuration;
-		const unsigned int songPlayed = player->songPlayed;
-		pthread_mutex_unlock (&player->lock);
+		const unsigned int songDuration = BarPlayerLoad (player->songDuration);
+		const unsigned int songPlayed = BarPlayerLoad (player->songPlayed);
 
 		fprintf (pipeWriteFd,
 				"stationName=%s\n"
@@ -949,14 +951,28 @@ void BarUiStartEventCmd (const BarSettings_t *settings, const char *type,
 				"pRetStr=%s\n"
 				"wRet=%i\n"
 				"wRetStr=%s\n"
-				"songPlayed=%u\n",
+				"songPlayed=%u\n"
+				"songPlayedMs=%u\n"
+				"bufferTarget=%u\n"
+				"underruns=%u\n"
+				"underrunMs=%u\n"
+				"underrunPos=%u\n"
+				"jitterUs=%u\n"
+				"wakeups=%u\n",
 				curStation == NULL ? "" : curStation->name,
 				songStation == NULL ? "" : songStation->name,
 				pRet,
 				PianoErrorToStr (pRet),
 				wRet,
 				curl_easy_strerror (wRet),
-				songPlayed
+				songPlayed,
+				BarPlayerGetPositionMs (player),
+				BarPlayerLoad (player->bufferTarget),
+				BarPlayerLoad (player->underruns),
+				BarPlayerLoad (player->underrunMs),
+				BarPlayerLoad (player->underrunPos),
+				BarPlayerLoad (player->jitterUs),
+				BarPlayerLoad (player->wakeups)
 				);
 
 		if (curSong != NULL) {
@@ -37,7 +37,7 @@ THE SOFTWARE.
 
 /*	standard eventcmd call
  */
-#define BarUiActDefaultEventcmd(name) BarUiStartEventCmd (&app->settings, \
+#define BarUiActDefaultEventcmd(name) BarUiStartEventCmd (app, \
 		name, selStation, selSong, &app->player, app->ph.stations, \
 		pRet, wRet)
 
@@ -53,13 +53,14 @@ static inline void BarUiDoSkipSong (player_t * const player) {
 	assert (player != NULL);
 
 	pthread_mutex_lock (&player->lock);
-	player->doQuit = true;
-	player->doPause = false;
+	BarPlayerStore (player->doQuit, true);
+	BarPlayerStore (player->doPause, false);
 	pthread_cond_broadcast (&player->cond);
 	pthread_mutex_unlock (&player->lock);
 	pthread_mutex_lock (&player->aoplayLock);
 	pthread_cond_broadcast (&player->aoplayCond);
 	pthread_mutex_unlock (&player->aoplayLock);
+	BarPlayerWakeup (player);
 }
 
 /*	transform station if necessary to allow changes like rename, rate, ...
@@ -376,7 +377,15 @@ BarUiActCallback(BarUiActDebug) {
 			"rating:\t%i\n"
 			"stationId:\t%s\n"
 			"title:\t%s\n"
-			"trackToken:\t%s\n",
+			"trackToken:\t%s\n"
+			"bufferHealth:\t%u\n"
+			"bufferTarget:\t%u\n"
+			"throughput:\t%u\n"
+			"underruns:\t%u\n"
+			"underrunMs:\t%u\n"
+			"underrunPos:\t%u\n"
+			"jitterUs:\t%u\n"
+			"wakeups:\t%u\n",
 			selSong->album,
 			selSong->artist,
 			selSong->audioFormat,
@@ -388,7 +397,15 @@ BarUiActCallback(BarUiActDebug) {
 			selSong->rating,
 			selSong->stationId,
 			selSong->title,
-			selSong->trackToken);
+			selSong->trackToken,
+			BarPlayerLoad (app->player.bufferHealth),
+			BarPlayerLoad (app->player.bufferTarget),
+			BarPlayerLoad (app->player.throughput),
+			BarPlayerLoad (app->player.underruns),
+			BarPlayerLoad (app->player.underrunMs),
+			BarPlayerLoad (app->player.underrunPos),
+			BarPlayerLoad (app->player.jitterUs),
+			BarPlayerLoad (app->player.wakeups));
 }
 
 /*	rate current song
@@ -430,7 +447,7 @@ BarUiActCallback(BarUiActSkipSong) {
  */
 BarUiActCallback(BarUiActPlay) {
 	pthread_mutex_lock (&app->player.lock);
-	app->player.doPause = false;
+	BarPlayerStore (app->player.doPause, false);
 	pthread_cond_broadcast (&app->player.cond);
 	pthread_mutex_unlock (&app->player.lock);
 }
@@ -439,7 +456,7 @@ BarUiActCallback(BarUiActPlay) {
  */
 BarUiActCallback(BarUiActPause) {
 	pthread_mutex_lock (&app->player.lock);
-	app->player.doPause = true;
+	BarPlayerStore (app->player.doPause, true);
 	pthread_cond_broadcast (&app->player.cond);
 	pthread_mutex_unlock (&app->player.lock);
 }
@@ -448,7 +465,7 @@ BarUiActCallback(BarUiActPause) {
  */
 BarUiActCallback(BarUiActTogglePause) {
 	pthread_mutex_lock (&app->player.lock);
-	app->player.doPause = !app->player.doPause;
+	BarPlayerStore (app->player.doPause, !app->player.doPause);
 	pthread_cond_broadcast (&app->player.cond);
 	pthread_mutex_unlock (&app->player.lock);
 }
@@ -668,6 +685,18 @@ BarUiActCallback(BarUiActVolReset) {
 	BarPlayerSetVolume (&app->player);
 }
 
+/*	seek backward
+ */
+BarUiActCallback(BarUiActSeekBack) {
+	BarPlayerSeek (&app->player, -(int) app->settings.seekStep);
+}
+
+/*	seek forward
+ */
+BarUiActCallback(BarUiActSeekForward) {
+	BarPlayerSeek (&app->player, app->settings.seekStep);
+}
+
 static const char *boolToYesNo (const bool value) {
 	return value ? "yes" : "no";
 }
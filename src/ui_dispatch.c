@@ -22,11 +22,50 @@ THE SOFTWARE.
 */
 
 #include <assert.h>
+#include <string.h>
 
 #include "ui_dispatch.h"
 #include "settings.h"
 #include "ui.h"
 
+/*	run action if context matches
+ *	@return BAR_KS_* if action was performed or BAR_KS_COUNT on error
+ */
+static BarKeyShortcutId_t BarUiDispatchRun (BarApp_t *app,
+		const BarKeyShortcutId_t i, PianoStation_t *selStation,
+		PianoSong_t *selSong, const bool verbose,
+		BarUiDispatchContext_t context) {
+	if ((dispatchActions[i].context & context) == dispatchActions[i].context) {
+		assert (dispatchActions[i].function != NULL);
+
+		dispatchActions[i].function (app, selStation, selSong,
+				context);
+		return i;
+	} else if (verbose) {
+		if (dispatchActions[i].context & BAR_DC_SONG) {
+			BarUiMsg (&app->settings, MSG_ERR, "No song playing.\n");
+		} else if (dispatchActions[i].context & BAR_DC_STATION) {
+			BarUiMsg (&app->settings, MSG_ERR, "No station selected.\n");
+		} else {
+			assert (0);
+		}
+	}
+	return BAR_KS_COUNT;
+}
+
+/*	get context for selected station/song
+ */
+static BarUiDispatchContext_t BarUiDispatchContext (PianoStation_t *selStation,
+		PianoSong_t *selSong, BarUiDispatchContext_t context) {
+	if (selStation != NULL) {
+		context |= BAR_DC_STATION;
+	}
+	if (selSong != NULL) {
+		context |= BAR_DC_SONG;
+	}
+	return context;
+}
+
 /*	handle global keyboard shortcuts
  *	@return BAR_KS_* if action was performed or BAR_KS_COUNT on error/if no
  *			action was performed
@@ -38,34 +77,38 @@ BarKeyShortcutId_t BarUiDispatch (BarApp_t *app, const char key, PianoStation_t
 	assert (sizeof (app->settings.keys) / sizeof (*app->settings.keys) ==
 			sizeof (dispatchActions) / sizeof (*dispatchActions));
 
-	if (selStation != NULL) {
-		context |= BAR_DC_STATION;
-	}
-	if (selSong != NULL) {
-		context |= BAR_DC_SONG;
-	}
+	context = BarUiDispatchContext (selStation, selSong, context);
 
 	for (size_t i = 0; i < BAR_KS_COUNT; i++) {
 		if (app->settings.keys[i] != BAR_KS_DISABLED &&
 				app->settings.keys[i] == key) {
-			if ((dispatchActions[i].context & context) == dispatchActions[i].context) {
-				assert (dispatchActions[i].function != NULL);
-
-				dispatchActions[i].function (app, selStation, selSong,
-						context);
-				return i;
-			} else if (verbose) {
-				if (dispatchActions[i].context & BAR_DC_SONG) {
-					BarUiMsg (&app->settings, MSG_ERR, "No song playing.\n");
-				} else if (dispatchActions[i].context & BAR_DC_STATION) {
-					BarUiMsg (&app->settings, MSG_ERR, "No station selected.\n");
-				} else {
-					assert (0);
-				}
-				return BAR_KS_COUNT;
+			const BarKeyShortcutId_t ret = BarUiDispatchRun (app, i,
+					selStation, selSong, verbose, context);
+			/* keep looking for other actions using the same key */
+			if (ret != BAR_KS_COUNT || verbose) {
+				return ret;
 			}
 		}
 	}
 	return BAR_KS_COUNT;
 }
 
+/*	run action by its config key (act_*), even if its shortcut is disabled
+ *	@return see BarUiDispatch
+ */
+BarKeyShortcutId_t BarUiDispatchByName (BarApp_t *app, const char * const name,
+		PianoStation_t *selStation, PianoSong_t *selSong, const bool verbose,
+		BarUiDispatchContext_t context) {
+	assert (app != NULL);
+	assert (name != NULL);
+
+	context = BarUiDispatchContext (selStation, selSong, context);
+
+	for (size_t i = 0; i < BAR_KS_COUNT; i++) {
+		if (strcmp (dispatchActions[i].configKey, name) == 0) {
+			return BarUiDispatchRun (app, i, selStation, selSong, verbose,
+					context);
+		}
+	}
+	return BAR_KS_COUNT;
+}
@@ -104,6 +104,10 @@ static const BarUiDispatchAction_t dispatchActions[BAR_KS_COUNT] = {
 				"act_volreset"},
 		{'!', BAR_DC_GLOBAL, BarUiActSettings, "change settings",
 				"act_settings"},
+		{'<', BAR_DC_GLOBAL | BAR_DC_STATION, BarUiActSeekBack,
+				"seek backward", "act_songseekback"},
+		{'>', BAR_DC_GLOBAL | BAR_DC_STATION, BarUiActSeekForward,
+				"seek forward", "act_songseekforward"},
 		};
 
 #include <piano.h>
@@ -112,4 +116,6 @@ static const BarUiDispatchAction_t dispatchActions[BAR_KS_COUNT] = {
 
 BarKeyShortcutId_t BarUiDispatch (BarApp_t *, const char, PianoStation_t *, PianoSong_t *,
 		const bool, BarUiDispatchContext_t);
+BarKeyShortcutId_t BarUiDispatchByName (BarApp_t *, const char * const,
+		PianoStation_t *, PianoSong_t *, const bool, BarUiDispatchContext_t);
 
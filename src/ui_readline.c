@@ -43,20 +43,111 @@ static size_t BarReadlinePrevUtf8 (char *ptr) {
 	return i;
 }
 
+/*	init input fds, stdin only
+ */
+void BarReadlineInit (BarReadlineFds_t *input) {
+	memset (input, 0, sizeof (*input));
+	input->fds[0].fd = STDIN_FILENO;
+	input->fds[0].events = POLLIN;
+	input->fds[1].fd = -1;
+	input->fds[1].events = POLLIN;
+	input->cur = -1;
+}
+
+/*	is there buffered input that has not been consumed yet?
+ */
+bool BarReadlinePending (const BarReadlineFds_t *input) {
+	for (size_t i = 0; i < sizeof (input->bufs) / sizeof (*input->bufs); i++) {
+		if (input->bufs[i].pos < input->bufs[i].len) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*	get next input character. Reads as much as possible at once and sticks to
+ *	one fd until its buffer is drained or the caller resets input->cur, so
+ *	input from stdin and fifo is never mixed.
+ *	@param input fds
+ *	@param timeout (milliseconds) or -1
+ *	@return character or -1 on timeout/interruption
+ */
+static int BarReadlineGetc (BarReadlineFds_t *input, int timeout) {
+	const size_t nfds = sizeof (input->fds) / sizeof (*input->fds);
+
+	while (true) {
+		/* buffered data first */
+		if (input->cur == -1) {
+			for (size_t i = 0; i < nfds; i++) {
+				if (input->bufs[i].pos < input->bufs[i].len) {
+					input->cur = i;
+					break;
+				}
+			}
+		}
+		if (input->cur != -1) {
+			BarReadlineBuf_t * const b = &input->bufs[input->cur];
+			if (b->pos < b->len) {
+				return (unsigned char) b->data[b->pos++];
+			}
+			b->pos = b->len = 0;
+		}
+
+		/* wait for more data, from the current fd only if there is one */
+		struct pollfd fds[2];
+		assert (sizeof (fds) == sizeof (input->fds));
+		memcpy (fds, input->fds, sizeof (fds));
+		if (input->cur != -1) {
+			fds[!input->cur].fd = -1;
+		}
+		if (poll (fds, nfds, timeout) <= 0) {
+			/* timeout or interrupted */
+			return -1;
+		}
+
+		for (size_t i = 0; i < nfds; i++) {
+			if (fds[i].revents == 0) {
+				continue;
+			}
+			BarReadlineBuf_t * const b = &input->bufs[i];
+			const ssize_t ret = read (input->fds[i].fd, b->data,
+					sizeof (b->data));
+			if (ret <= 0) {
+				/* poll() is going wild if it contains EOFed stdin, only check
+				 * for stdin, fifo is "reopened" as soon as another writer is
+				 * available
+				 * FIXME: ugly */
+				if (input->fds[i].fd == STDIN_FILENO) {
+					input->fds[i].fd = -1;
+					if (input->cur == (int) i) {
+						input->cur = -1;
+					}
+				}
+				continue;
+			}
+			b->pos = 0;
+			b->len = ret;
+			if (input->cur == -1) {
+				input->cur = i;
+			}
+			break;
+		}
+	}
+}
+
 /*	readline replacement
  *	@param buffer
  *	@param buffer size
  *	@param accept these characters
  *	@param input fds
  *	@param flags
- *	@param timeout (seconds) or -1 (no timeout)
+ *	@param timeout (seconds), 0 (do not block) or -1 (no timeout)
  *	@return number of bytes read from stdin
  */
 size_t BarReadline (char *buf, const size_t bufSize, const char *mask,
 		BarReadlineFds_t *input, const BarReadlineFlags_t flags, int timeout) {
 	size_t bufLen = 0;
 	unsigned char escapeState = 0;
-	fd_set set;
 	const bool echo = !(flags & BAR_RL_NOECHO);
 	bool done = false;
 
@@ -73,41 +164,16 @@ size_t BarReadline (char *buf, const size_t bufSize, const char *mask,
 
 	memset (buf, 0, bufSize);
 
-	/* if fd is a fifo fgetc will always return EOF if nobody writes to
-	 * it, stdin will block */
 	while (!done) {
-		int curFd = -1;
-		unsigned char chr;
-		struct timeval timeoutstruct;
-
-		/* select modifies set and timeout */
-		memcpy (&set, &input->set, sizeof (set));
-		timeoutstruct.tv_sec = timeout;
-		timeoutstruct.tv_usec = 0;
-
-		if (select (input->maxfd, &set, NULL, NULL,
-				(timeout == -1) ? NULL : &timeoutstruct) <= 0) {
+		const int c = BarReadlineGetc (input,
+				(timeout == -1) ? -1 : timeout*1000);
+		if (c == -1) {
 			/* timeout or interrupted */
 			bufLen = 0;
 			break;
 		}
+		const unsigned char chr = c;
 
-		assert (sizeof (input->fds) / sizeof (*input->fds) == 2);
-		if (FD_ISSET(input->fds[0], &set)) {
-			curFd = input->fds[0];
-		} else if (input->fds[1] != -1 && FD_ISSET(input->fds[1], &set)) {
-			curFd = input->fds[1];
-		}
-		if (read (curFd, &chr, sizeof (chr)) <= 0) {
-			/* select() is going wild if fdset contains EOFed stdin, only check
-			 * for stdin, fifo is "reopened" as soon as another writer is
-			 * available
-			 * FIXME: ugly */
-			if (curFd == STDIN_FILENO) {
-				FD_CLR (curFd, &input->set);
-			}
-			continue;
-		}
 		switch (chr) {
 			/* EOT */
 			case 4:
@@ -197,6 +263,13 @@ size_t BarReadline (char *buf, const size_t bufSize, const char *mask,
 		fputs ("\n", stdout);
 	}
 
+	/* line is complete, input from the other fd may be used now, unless there
+	 * is more buffered input from this one */
+	if (input->cur != -1 &&
+			input->bufs[input->cur].pos >= input->bufs[input->cur].len) {
+		input->cur = -1;
+	}
+
 	interrupted = prevInt;
 
 	buf[bufLen] = '\0';
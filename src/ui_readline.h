@@ -24,7 +24,7 @@ THE SOFTWARE.
 #pragma once
 
 #include <stdbool.h>
-#include <sys/select.h>
+#include <poll.h>
 
 /* bitfield */
 typedef enum {
@@ -34,10 +34,19 @@ typedef enum {
 	BAR_RL_NOINT = 4, /* don’t change interrupted variable */
 } BarReadlineFlags_t;
 
+/* input read from an fd, but not consumed yet */
 typedef struct {
-	fd_set set;
-	int maxfd;
-	int fds[2];
+	char data[4096];
+	size_t pos, len;
+} BarReadlineBuf_t;
+
+/* stdin and control fifo, disabled entries have a negative fd */
+typedef struct {
+	struct pollfd fds[2];
+	BarReadlineBuf_t bufs[2];
+	/* index of fd input is taken from until its buffer is empty or the line
+	 * is complete, -1 if none */
+	int cur;
 } BarReadlineFds_t;
 
 size_t BarReadline (char *, const size_t, const char *,
@@ -46,4 +55,6 @@ size_t BarReadlineStr (char *, const size_t,
 		BarReadlineFds_t *, const BarReadlineFlags_t);
 size_t BarReadlineInt (int *, BarReadlineFds_t *);
 bool BarReadlineYesNo (bool, BarReadlineFds_t *);
+void BarReadlineInit (BarReadlineFds_t *);
+bool BarReadlinePending (const BarReadlineFds_t *);
 